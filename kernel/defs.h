@@ -2,6 +2,7 @@ struct buf;
 struct context;
 struct file;
 struct inode;
+struct kmem_cache;
 struct pipe;
 struct proc;
 struct spinlock;
@@ -65,6 +66,15 @@ void            ramdiskrw(struct buf*);
 // kalloc.c
 void*           kalloc(void);
 void            kfree(void *);
+void*           kallocpages(int);
+void            kfreepages(void *, int);
+void            kpageref(void *);
+int             kpagerefs(void *);
+
+// slab.c
+struct kmem_cache* kmem_cache_create(char*, uint);
+void*           kmem_cache_alloc(struct kmem_cache*);
+void            kmem_cache_free(struct kmem_cache*, void*);
 void            kinit(void);
 
 // log.c
@@ -74,6 +84,7 @@ void            begin_op(void);
 void            end_op(void);
 
 // pipe.c
+void            pipeinit(void);
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
 int             piperead(struct pipe*, uint64, int);
@@ -89,7 +100,6 @@ int             cpuid(void);
 void            exit(int);
 int             fork(void);
 int             growproc(int);
-void            proc_mapstacks(pagetable_t);
 pagetable_t     proc_pagetable(struct proc *);
 void            proc_freepagetable(pagetable_t, uint64);
 int             kill(int);
@@ -103,30 +113,32 @@ void            sleep(void*, struct spinlock*);
 void            userinit(void);
 int             wait(uint64);
 void            wakeup(void*);
+void            wakeupone(void*);
+void            wakeuphandoff(void*);
 void            yield(void);
 int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
 void            procdump(void);
-int             waitx(uint64, uint*, uint*);
-void            update_time(void);
+int             waitx(uint64, uint*, uint*, uint64);
 int             setpriority(int, int);
-
-// #ifdef MLFQ
-// struct queue 
-// {
-//   int start;                 // start index
-//   int end;                   // end index
-//   struct proc *que[63];     // array of `struct proc` pointers
-// };
-
-// struct queue mlfq[5];
-
-// void pushback(struct queue *, struct proc *);          // pushing process to the end of the queue
-// void deletefront(struct queue *);                      // deleting process 
-// void deleteIdx(struct queue *, int);                   // deleting process with given index in the queue (for ageing)
-// int size(struct queue *);                              // size of the Queue
-// void ageproc(void);                             // ageing the processes 
-// #endif
+void            runqbalance(void);
+int             schedtick(struct proc*);
+void            mlfqage(void);
+int             setpolicy(int, int);
+int             setslice(int, int);
+int             setaffinity(int, uint);
+int             getaffinity(int);
+int             setdeadline(int, int, int);
+void            quotaperiod(void);
+void            edfrelease(void);
+int             setpgid(int, int);
+int             getpgid(int);
+int             setquota(int, int);
+int             quotastat(int, uint*, uint*);
+int             schedstat(int, uint64);
+void            lendtickets(struct proc*, int);
+void            returntickets(void);
+int             needresched(void);
 
 // swtch.S
 void            swtch(struct context*, struct context*);
@@ -168,6 +180,15 @@ void            trapinit(void);
 void            trapinithart(void);
 extern struct spinlock tickslock;
 void            usertrapret(void);
+void            ipi(int);
+int             ticksleep(int);
+int             nanosleep(uint64);
+
+// trace.c
+void            traceinit(void);
+void            trace(struct proc*, int);
+int             schedtrace(int);
+int             readtrace(uint64, int);
 
 // uart.c
 void            uartinit(void);
@@ -181,11 +202,15 @@ void            kvminit(void);
 void            kvminithart(void);
 void            kvmmap(pagetable_t, uint64, uint64, uint64, int);
 int             mappages(pagetable_t, uint64, uint64, uint64, int);
+int             kvmmapstack(uint64, uint64);
+void            kvmunmapstack(uint64);
 pagetable_t     uvmcreate(void);
 void            uvminit(pagetable_t, uchar *, uint);
 uint64          uvmalloc(pagetable_t, uint64, uint64);
 uint64          uvmdealloc(pagetable_t, uint64, uint64);
 int             uvmcopy(pagetable_t, pagetable_t, uint64);
+int             cowfault(pagetable_t, uint64);
+int             lazyfault(pagetable_t, uint64, uint64);
 void            uvmfree(pagetable_t, uint64);
 void            uvmunmap(pagetable_t, uint64, uint64, int);
 void            uvmclear(pagetable_t, uint64);
@@ -3,6 +3,7 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "spinlock.h"
+#include "policy.h"
 #include "proc.h"
 #include "defs.h"
 #include "elf.h"
@@ -115,7 +116,7 @@ exec(char *path, char **argv)
   p->trapframe->epc = elf.entry;  // initial program counter = main
   p->trapframe->sp = sp; // initial stack pointer
 
-  p->priority = 5;  //shell processes have higher priority
+  p->ps.priority = 5;  //shell processes have higher priority
   
   proc_freepagetable(oldpagetable, oldsz);
 
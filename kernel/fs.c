@@ -15,6 +15,7 @@
 #include "param.h"
 #include "stat.h"
 #include "spinlock.h"
+#include "policy.h"
 #include "proc.h"
 #include "sleeplock.h"
 #include "fs.h"
@@ -167,24 +168,27 @@ bfree(int dev, uint b)
 // and ip->dev and ip->inum indicate which i-node an entry
 // holds, one must hold itable.lock while using any of those fields.
 //
+// The table is a list of inodes from inodecache. It grows as
+// inodes are referenced; once it holds NINODE, iget() recycles
+// unreferenced entries, and iput() frees them, rather than keep
+// more than NINODE.
+//
 // An ip->lock sleep-lock protects all ip-> fields other than ref,
 // dev, and inum.  One must hold ip->lock in order to
 // read or write that inode's ip->valid, ip->size, ip->type, &c.
 
 struct {
   struct spinlock lock;
-  struct inode inode[NINODE];
+  struct inode *inodes;
+  int n;
+  struct kmem_cache *inodecache;
 } itable;
 
 void
 iinit()
 {
-  int i = 0;
-  
   initlock(&itable.lock, "itable");
-  for(i = 0; i < NINODE; i++) {
-    initsleeplock(&itable.inode[i].lock, "inode");
-  }
+  itable.inodecache = kmem_cache_create("inode", sizeof(struct inode));
 }
 
 static struct inode* iget(uint dev, uint inum);
@@ -248,7 +252,7 @@ iget(uint dev, uint inum)
 
   // Is the inode already in the table?
   empty = 0;
-  for(ip = &itable.inode[0]; ip < &itable.inode[NINODE]; ip++){
+  for(ip = itable.inodes; ip; ip = ip->next){
     if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
       ip->ref++;
       release(&itable.lock);
@@ -258,7 +262,16 @@ iget(uint dev, uint inum)
       empty = ip;
   }
 
-  // Recycle an inode entry.
+  // Add an inode entry, or recycle one.
+  if(empty == 0 || itable.n < NINODE){
+    if((ip = kmem_cache_alloc(itable.inodecache)) != 0){
+      initsleeplock(&ip->lock, "inode");
+      ip->next = itable.inodes;
+      itable.inodes = ip;
+      itable.n++;
+      empty = ip;
+    }
+  }
   if(empty == 0)
     panic("iget: no inodes");
 
@@ -354,6 +367,14 @@ iput(struct inode *ip)
   }
 
   ip->ref--;
+  if(ip->ref == 0 && itable.n > NINODE){
+    struct inode **pp;
+    for(pp = &itable.inodes; *pp != ip; pp = &(*pp)->next)
+      ;
+    *pp = ip->next;
+    itable.n--;
+    kmem_cache_free(itable.inodecache, ip);
+  }
   release(&itable.lock);
 }
 
@@ -1,6 +1,26 @@
 // Physical memory allocator, for user processes,
 // kernel stacks, page-table pages,
-// and pipe buffers. Allocates whole 4096-byte pages.
+// and pipe buffers. Allocates whole 4096-byte pages,
+// or with kallocpages() physically contiguous blocks
+// of 2^order pages.
+//
+// Free memory is kept by a buddy allocator: a list of
+// free blocks for each order, a block of 2^order pages
+// starting at a multiple of 2^order pages from KERNBASE.
+// Allocating splits a larger block in halves as needed;
+// freeing joins a block with its buddy, the other half
+// of the block they were split from, while that is free.
+//
+// Each cpu keeps a cache of free single pages, so that
+// most kalloc()s and kfree()s take only that cpu's lock.
+// A cache is refilled from, and drained to, the buddy
+// allocator KBATCH pages at a time; when that is empty
+// too, a cpu steals half of another cpu's cache.
+//
+// Single pages have a reference count, so that fork()
+// can share user pages copy-on-write: kalloc() sets it
+// to 1, kpageref() adds one, and kfree() frees the page
+// only when it drops to 0.
 
 #include "types.h"
 #include "param.h"
@@ -9,24 +29,52 @@
 #include "riscv.h"
 #include "defs.h"
 
+#define KBATCH    32   // pages moved to or from kmem at a time
+#define KCACHEMAX 64   // most pages a cpu's cache holds
+#define NPAGE ((PHYSTOP - KERNBASE) / PGSIZE)
+
+#define PA2PG(pa) (((uint64)(pa) - KERNBASE) / PGSIZE)
+#define PG2PA(pg) ((struct run*)(KERNBASE + (uint64)(pg) * PGSIZE))
+
 void freerange(void *pa_start, void *pa_end);
 
 extern char end[]; // first address after kernel.
                    // defined by kernel.ld.
 
+// A free page or block. prev is used only on the
+// buddy lists, so that a buddy can be unlinked from
+// the middle of one.
 struct run {
   struct run *next;
+  struct run *prev;
 };
 
 struct {
   struct spinlock lock;
-  struct run *freelist;
+  struct run *free[NORDER];   // free blocks of each order
+  int nfree[NORDER];
+  uchar order[NPAGE];         // 1 + order of the free block
+                              // starting at a page, else 0
 } kmem;
 
+// A cpu's cache of free pages. Its lock is taken by the
+// cpu itself, and by other cpus only to steal pages.
+struct kcache {
+  struct spinlock lock;
+  struct run *freelist;
+  int n;
+} kcaches[NCPU];
+
+static int pageref[NPAGE];   // references to each single page
+
+static void buddyfree(struct run *r, int order);
+
 void
 kinit()
 {
   initlock(&kmem.lock, "kmem");
+  for(int i = 0; i < NCPU; i++)
+    initlock(&kcaches[i].lock, "kcache");
   freerange(end, (void*)PHYSTOP);
 }
 
@@ -35,31 +83,217 @@ freerange(void *pa_start, void *pa_end)
 {
   char *p;
   p = (char*)PGROUNDUP((uint64)pa_start);
-  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE)
-    kfree(p);
+  acquire(&kmem.lock);
+  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE){
+    memset(p, 1, PGSIZE);
+    buddyfree((struct run*)p, 0);
+  }
+  release(&kmem.lock);
+}
+
+static void
+pushblock(struct run *r, int order)
+{
+  r->prev = 0;
+  r->next = kmem.free[order];
+  if(r->next)
+    r->next->prev = r;
+  kmem.free[order] = r;
+  kmem.nfree[order]++;
+  kmem.order[PA2PG(r)] = order + 1;
+}
+
+static void
+unlinkblock(struct run *r, int order)
+{
+  if(r->prev)
+    r->prev->next = r->next;
+  else
+    kmem.free[order] = r->next;
+  if(r->next)
+    r->next->prev = r->prev;
+  kmem.nfree[order]--;
+  kmem.order[PA2PG(r)] = 0;
+}
+
+// Take a free block of 2^order pages, splitting a
+// larger one if need be. Returns 0 if there is none.
+// Caller must hold kmem.lock.
+static struct run*
+buddyalloc(int order)
+{
+  struct run *r;
+  uint64 pg;
+  int o;
+
+  for(o = order; o < NORDER && kmem.free[o] == 0; o++)
+    ;
+  if(o == NORDER)
+    return 0;
+  r = kmem.free[o];
+  unlinkblock(r, o);
+
+  // give back the upper half until r is the size asked for.
+  pg = PA2PG(r);
+  while(o > order){
+    o--;
+    pushblock(PG2PA(pg + (1L << o)), o);
+  }
+  return r;
+}
+
+// Free the block of 2^order pages at r, joining it
+// with its buddy for as long as that is free too.
+// Caller must hold kmem.lock.
+static void
+buddyfree(struct run *r, int order)
+{
+  uint64 pg = PA2PG(r), buddy;
+
+  while(order < NORDER - 1){
+    buddy = pg ^ (1L << order);
+    if(buddy >= NPAGE || kmem.order[buddy] != order + 1)
+      break;
+    unlinkblock(PG2PA(buddy), order);
+    if(buddy < pg)
+      pg = buddy;
+    order++;
+  }
+  pushblock(PG2PA(pg), order);
+}
+
+// Move all of cpu id's cached pages back to the buddy
+// allocator, so that they can join into larger blocks.
+static void
+flushcache(int id)
+{
+  struct kcache *kc = &kcaches[id];
+  struct run *list, *r;
+
+  acquire(&kc->lock);
+  list = kc->freelist;
+  kc->freelist = 0;
+  kc->n = 0;
+  release(&kc->lock);
+
+  acquire(&kmem.lock);
+  while((r = list) != 0){
+    list = r->next;
+    buddyfree(r, 0);
+  }
+  release(&kmem.lock);
+}
+
+// Take up to n pages off the list *from, and return
+// them as a list; *got is set to how many.
+static struct run*
+takepages(struct run **from, int n, int *got)
+{
+  struct run *head = *from, *r = 0;
+  int i;
+
+  for(i = 0; i < n && *from; i++){
+    r = *from;
+    *from = r->next;
+  }
+  if(r)
+    r->next = 0;
+  *got = i;
+  return i ? head : 0;
+}
+
+// Get pages for cpu id's empty cache, from kmem or
+// else from another cpu. Returns one of them, putting
+// the rest in the cache; or 0 if there are none.
+// Called with interrupts off.
+static struct run*
+refill(int id)
+{
+  struct kcache *kc = &kcaches[id], *victim;
+  struct run *list = 0, *r;
+  int n;
+
+  acquire(&kmem.lock);
+  for(n = 0; n < KBATCH && (r = buddyalloc(0)) != 0; n++){
+    r->next = list;
+    list = r;
+  }
+  release(&kmem.lock);
+
+  // steal half of another cpu's cache. Only one
+  // cache lock is held at a time, so cpus stealing
+  // from each other can't deadlock.
+  for(int i = 1; list == 0 && i < NCPU; i++){
+    victim = &kcaches[(id + i) % NCPU];
+    if(victim->n == 0)
+      continue;
+    acquire(&victim->lock);
+    list = takepages(&victim->freelist, (victim->n + 1) / 2, &n);
+    victim->n -= n;
+    release(&victim->lock);
+  }
+
+  if(list == 0)
+    return 0;
+  r = list;
+  if(n > 1){
+    struct run *tail = list->next;
+    while(tail->next)
+      tail = tail->next;
+    acquire(&kc->lock);
+    tail->next = kc->freelist;
+    kc->freelist = list->next;
+    kc->n += n - 1;
+    release(&kc->lock);
+  }
+  return r;
 }
 
 // Free the page of physical memory pointed at by v,
 // which normally should have been returned by a
-// call to kalloc().  (The exception is when
-// initializing the allocator; see kinit above.)
+// call to kalloc().
 void
 kfree(void *pa)
 {
-  struct run *r;
+  struct run *r, *drain = 0;
+  struct kcache *kc;
+  int n;
 
   if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
     panic("kfree");
 
+  // a page shared copy-on-write is freed by its last user.
+  n = __sync_sub_and_fetch(&pageref[PA2PG(pa)], 1);
+  if(n > 0)
+    return;
+  if(n < 0)
+    panic("kfree: ref");
+
   // Fill with junk to catch dangling refs.
   memset(pa, 1, PGSIZE);
 
   r = (struct run*)pa;
 
-  acquire(&kmem.lock);
-  r->next = kmem.freelist;
-  kmem.freelist = r;
-  release(&kmem.lock);
+  push_off();
+  kc = &kcaches[cpuid()];
+  acquire(&kc->lock);
+  r->next = kc->freelist;
+  kc->freelist = r;
+  if(++kc->n > KCACHEMAX){
+    drain = takepages(&kc->freelist, KBATCH, &n);
+    kc->n -= n;
+  }
+  release(&kc->lock);
+
+  if(drain){
+    acquire(&kmem.lock);
+    while((r = drain) != 0){
+      drain = r->next;
+      buddyfree(r, 0);
+    }
+    release(&kmem.lock);
+  }
+  pop_off();
 }
 
 // Allocate one 4096-byte page of physical memory.
@@ -69,14 +303,95 @@ void *
 kalloc(void)
 {
   struct run *r;
+  struct kcache *kc;
+  int id;
+
+  push_off();
+  id = cpuid();
+  kc = &kcaches[id];
+  acquire(&kc->lock);
+  r = kc->freelist;
+  if(r){
+    kc->freelist = r->next;
+    kc->n--;
+  }
+  release(&kc->lock);
+  if(r == 0)
+    r = refill(id);
+  pop_off();
+
+  if(r){
+    pageref[PA2PG(r)] = 1;
+    memset((char*)r, 5, PGSIZE); // fill with junk
+  }
+  return (void*)r;
+}
+
+// Add a reference to the page at pa, which must
+// have come from kalloc() and not yet be freed.
+void
+kpageref(void *pa)
+{
+  if(__sync_fetch_and_add(&pageref[PA2PG(pa)], 1) < 1)
+    panic("kpageref");
+}
+
+// The number of references to the page at pa.
+int
+kpagerefs(void *pa)
+{
+  return pageref[PA2PG(pa)];
+}
+
+// Allocate 2^order physically contiguous pages, aligned
+// to their size, for 0 <= order < NORDER. Returns 0 if
+// the memory cannot be allocated.
+void *
+kallocpages(int order)
+{
+  struct run *r;
+
+  if(order == 0)
+    return kalloc();
+  if(order < 0 || order >= NORDER)
+    return 0;
 
   acquire(&kmem.lock);
-  r = kmem.freelist;
-  if(r)
-    kmem.freelist = r->next;
+  r = buddyalloc(order);
   release(&kmem.lock);
 
+  // pages sitting in the cpus' caches may be what
+  // keeps their blocks from joining; try again
+  // without them.
+  for(int i = 0; r == 0 && i < NCPU; i++){
+    flushcache(i);
+    acquire(&kmem.lock);
+    r = buddyalloc(order);
+    release(&kmem.lock);
+  }
+
   if(r)
-    memset((char*)r, 5, PGSIZE); // fill with junk
+    memset((char*)r, 5, PGSIZE << order); // fill with junk
   return (void*)r;
 }
+
+// Free 2^order pages at pa, which normally should
+// have been returned by kallocpages(order).
+void
+kfreepages(void *pa, int order)
+{
+  if(order == 0){
+    kfree(pa);
+    return;
+  }
+  if(order < 0 || order >= NORDER || ((uint64)pa % (PGSIZE << order)) != 0 ||
+     (char*)pa < end || (uint64)pa + (PGSIZE << order) > PHYSTOP)
+    panic("kfreepages");
+
+  // Fill with junk to catch dangling refs.
+  memset(pa, 1, PGSIZE << order);
+
+  acquire(&kmem.lock);
+  buddyfree((struct run*)pa, order);
+  release(&kmem.lock);
+}
@@ -158,8 +158,9 @@ end_op(void)
   } else {
     // begin_op() may be waiting for log space,
     // and decrementing log.outstanding has decreased
-    // the amount of reserved space.
-    wakeup(&log);
+    // the amount of reserved space, enough for
+    // one more operation.
+    wakeupone(&log);
   }
   release(&log.lock);
 
@@ -27,8 +27,10 @@
 
 // core local interruptor (CLINT), which contains the timer.
 #define CLINT 0x2000000L
+#define CLINT_MSIP(hartid) (CLINT + 4*(hartid))
 #define CLINT_MTIMECMP(hartid) (CLINT + 0x4000 + 8*(hartid))
 #define CLINT_MTIME (CLINT + 0xBFF8) // cycles since boot.
+#define MTIMEHZ 10000000              // CLINT_MTIME cycles per second in qemu.
 
 // qemu puts platform-level interrupt controller (PLIC) here.
 #define PLIC 0x0c000000L
@@ -51,9 +53,13 @@
 // in both user and kernel space.
 #define TRAMPOLINE (MAXVA - PGSIZE)
 
-// map kernel stacks beneath the trampoline,
-// each surrounded by invalid guard pages.
-#define KSTACK(p) (TRAMPOLINE - ((p)+1)* 2*PGSIZE)
+// map kernel stacks beneath the trampoline, each
+// 2^KSTACKORDER pages with an invalid guard page below.
+// Slot p's stack is mapped only while struct proc
+// number p has one; see kstackalloc() in proc.c.
+#define KSTACKORDER 1
+#define KSTACKSIZE (PGSIZE << KSTACKORDER)
+#define KSTACK(p) (TRAMPOLINE - ((p)+1) * (KSTACKSIZE + PGSIZE))
 
 // User memory layout.
 // Address zero first:
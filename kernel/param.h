@@ -1,8 +1,24 @@
-#define NPROC        64  // maximum number of processes
+#define NPROC      2048  // maximum number of processes
+#define NPIDHASH    251  // pid hash buckets
+#define NPROCKEEP    64  // free struct procs that keep their kernel stacks
 #define NCPU          8  // maximum number of CPUs
+#define BALANCEINT    5  // ticks between run queue rebalances
+#define NMLFQ         5  // number of MLFQ levels
+#define MLFQAGE      30  // ticks a process waits before MLFQ promotes it
+#define CFSGRAN    1024  // vruntime a nice-0 process gains per tick
+#define CFSLATENCY 4096  // most vruntime a waking process may be behind (CFS)
+#define STRIDE1 (1<<20)  // pass a 1-ticket process gains per tick (STRIDE)
+#define EDFUTIL      90  // percent of a cpu EDF tasks may reserve
+#define NPGROUP      16  // maximum number of process groups with cpu quotas
+#define QUOTAPERIOD  10  // ticks per cpu quota period
+#define NWAITQ       61  // sleep channel hash buckets
+#define NTIMER       64  // timer wheel slots, for sleep()
+#define TICKCYCLES 1000000  // CLINT_MTIME cycles per timer interrupt
+#define NLATHIST     24  // run queue wait histogram buckets, powers of 2 us
+#define NORDER       11  // buddy allocator blocks are 2^0..2^(NORDER-1) pages
+#define NTRACE     4096  // scheduler trace events kept per cpu
 #define NOFILE       16  // open files per process
-#define NFILE       100  // open files per system
-#define NINODE       50  // maximum number of active i-nodes
+#define NINODE       50  // i-nodes the inode table keeps cached
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
@@ -0,0 +1,259 @@
+// Scheduling policies' sort keys and tick handlers,
+// shared by proc.c and the host scheduler simulator,
+// sim/schedsim.c, so that the simulator's policies
+// decide as the kernel's do. They work on the fields
+// below, which struct proc and the simulator's struct
+// task both embed; the callers fill in what depends on
+// the other processes around, such as which is waiting
+// first. Needs types.h and param.h.
+
+// A process's scheduling state, p->ps.
+struct policystate {
+  int priority;               // static priority, 0 (highest) to 100
+  int level;                  // MLFQ level, 0 is the highest
+  int slice;                  // ticks used of this slice, or of the level's allotment (MLFQ)
+  uint64 vruntime;            // weighted run time (CFS)
+  uint64 pass;                // run time in strides (STRIDE)
+  int dlruntime;              // ticks needed each period (EDF)
+  int dlperiod;               // ticks between job releases (EDF)
+  int dldeadline;             // ticks from release to deadline (EDF)
+  uint dlabs;                 // tick of the current deadline (EDF)
+  int dlleft;                 // ticks left of this period's runtime (EDF)
+};
+
+// A run queue's, rq->pq.
+struct policyq {
+  uint64 seq;                 // enqueue counter, breaks ties FIFO
+  uint64 minvruntime;         // least vruntime that ran here (CFS)
+  uint64 minpass;             // least pass that ran here (STRIDE)
+};
+
+// PBS dynamic priority, from a process's static priority
+// and the share of its life it has spent sleeping, its
+// niceness (0 to 10), which is stored in *niceness.
+static inline int
+pbsprio(int priority, uint64 rtime, uint64 stime, int *niceness)
+{
+  int dp;
+
+  // niceness = Int( ticks in sleeping state/ticks in running+sleeping state)*10
+  if(rtime + stime == 0 || stime == 0)
+    *niceness = 0;
+  else
+    *niceness = (stime * 10) / (rtime + stime);
+
+  // DP = max(0, min(SP − niceness + 5, 100))
+  dp = priority - *niceness + 5;
+  if(dp > 100)
+    dp = 100;
+  if(dp < 0)
+    dp = 0;
+  return dp;
+}
+
+// CFS weight of a process with this priority. The default
+// priority of 60 is nice 0, and every 2 priority points
+// is one nice level.
+static inline int
+cfsweight(int priority)
+{
+  // Load weight of each nice level from -20 to 19, as in Linux:
+  // each level gets about 10% less CPU than the one above it.
+  static const int cfs_weights[40] = {
+    88761, 71755, 56483, 46273, 36291,
+    29154, 23254, 18705, 14949, 11916,
+     9548,  7620,  6100,  4904,  3906,
+     3121,  2501,  1991,  1586,  1277,
+     1024,   820,   655,   526,   423,
+      335,   272,   215,   172,   137,
+      110,    87,    70,    56,    45,
+       36,    29,    23,    18,    15,
+  };
+  int nice = (priority - 60) / 2;
+
+  if(nice < -20)
+    nice = -20;
+  if(nice > 19)
+    nice = 19;
+  return cfs_weights[nice + 20];
+}
+
+// vruntime a process with this priority gains per tick (CFS).
+static inline uint64
+cfsdelta(int priority)
+{
+  return (CFSGRAN * 1024) / cfsweight(priority);
+}
+
+// Stride tickets of a process with this priority: the
+// lower its priority number, the more, from 1 at priority
+// 100 to 101 at 0.
+static inline int
+stridetickets(int priority)
+{
+  int n = 101 - priority;
+
+  if(n < 1)
+    n = 1;
+  if(n > 101)
+    n = 101;
+  return n;
+}
+
+// Sort keys: of the processes waiting in q, the one
+// with the smallest key runs first. The low bits of
+// most count enqueues, so that processes with equal
+// keys are served in FIFO order.
+
+static inline uint64
+rrkey(struct policyq *q)
+{
+  return q->seq++;
+}
+
+// ctime is the tick the process was created.
+static inline uint64
+fcfskey(struct policyq *q, int ctime)
+{
+  return ((uint64)ctime << 24) | (q->seq++ & 0xffffff);
+}
+
+// dp is the process's pbsprio().
+static inline uint64
+pbskey(struct policyq *q, int dp)
+{
+  return ((uint64)dp << 24) | (q->seq++ & 0xffffff);
+}
+
+static inline uint64
+cfskey(struct policyq *q, struct policystate *s)
+{
+  // a process that slept a long time, or comes from
+  // another cpu, mustn't be far behind the others
+  // here, or it would hog the cpu to catch up.
+  if(s->vruntime + CFSLATENCY < q->minvruntime)
+    s->vruntime = q->minvruntime - CFSLATENCY;
+  return s->vruntime;
+}
+
+static inline uint64
+stridekey(struct policyq *q, struct policystate *s)
+{
+  // a process that slept doesn't get to run
+  // alone until its pass catches up.
+  if(s->pass < q->minpass)
+    s->pass = q->minpass;
+  return s->pass;
+}
+
+// Start an EDF period released at tick release:
+// refill its runtime and set its deadline.
+static inline void
+edfrefill(struct policystate *s, uint release)
+{
+  s->dlabs = release + s->dldeadline;
+  s->dlleft = s->dlruntime;
+}
+
+// The tick s's next EDF period is released at.
+static inline uint
+edfnext(struct policystate *s)
+{
+  return s->dlabs - s->dldeadline + s->dlperiod;
+}
+
+static inline uint64
+edfkey(struct policyq *q, struct policystate *s, uint now)
+{
+  // a job released after the last deadline passed:
+  // a new period starts now.
+  if((int)(now - s->dlabs) >= 0)
+    edfrefill(s, now);
+  return ((uint64)s->dlabs << 24) | (q->seq++ & 0xffffff);
+}
+
+// s was picked from q to run: keep q's least vruntime
+// and pass up to date, for cfskey() and stridekey().
+static inline void
+cfsran(struct policyq *q, struct policystate *s)
+{
+  if(s->vruntime > q->minvruntime)
+    q->minvruntime = s->vruntime;
+}
+
+static inline void
+strideran(struct policyq *q, struct policystate *s)
+{
+  if(s->pass > q->minpass)
+    q->minpass = s->pass;
+}
+
+// Timer tick handlers: charge a tick to the running
+// process s, and return 1 if it should give up the cpu.
+// slice is the policy's time slice, in ticks.
+
+// RR, FCFS, PBS: yield after slice ticks, to the next
+// process in the queue, or to s itself if it is still
+// first. A slice of 0 runs s until it blocks or a
+// better process preempts it.
+static inline int
+slicetick(struct policystate *s, int slice)
+{
+  if(slice == 0 || ++s->slice < slice)
+    return 0;
+  s->slice = 0;
+  return 1;
+}
+
+// MLFQ: a process may use slice << level ticks (1, 2, 4,
+// 8, 16 with the default slice) at each level. Once it
+// has, it moves down a level and yields. It also yields
+// if a process at a higher level is waiting; bit i of
+// waiting is set if one at level i is. Sleeping doesn't
+// reset the allotment, so a process can't stay high by
+// giving up the cpu just before it runs out.
+static inline int
+mlfqtick(struct policystate *s, int slice, uint waiting)
+{
+  int level = s->level;
+
+  if(slice && ++s->slice >= (slice << level)){
+    if(level < NMLFQ-1)
+      s->level = level + 1;
+    s->slice = 0;
+    return 1;
+  }
+  return (waiting & ((1 << level) - 1)) != 0;
+}
+
+// CFS: s's vruntime grows by CFSGRAN per tick for a
+// nice-0 process, in inverse proportion to its weight.
+// It yields once it is more than slice nice-0 ticks
+// ahead of first, the CFS process with the least
+// vruntime waiting, if there is one.
+static inline int
+cfstick(struct policystate *s, int slice, struct policystate *first)
+{
+  s->vruntime += cfsdelta(s->priority);
+  return first && first->vruntime + (uint64)slice * CFSGRAN < s->vruntime;
+}
+
+// STRIDE: s's pass advances by its stride, STRIDE1 over
+// its tickets, for each tick it runs. The process with
+// the least pass runs next, so over time each gets ticks
+// in proportion to its tickets.
+static inline int
+stridetick(struct policystate *s, int slice, int tickets)
+{
+  s->pass += STRIDE1 / tickets;
+  return slicetick(s, slice);
+}
+
+// EDF: charge the tick to s's runtime for this period,
+// and yield once that is used up. The kernel then keeps
+// s off the run queues until edfnext().
+static inline int
+edftick(struct policystate *s)
+{
+  return --s->dlleft <= 0;
+}
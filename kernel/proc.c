@@ -3,20 +3,109 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "spinlock.h"
+#include "policy.h"
 #include "proc.h"
+#include "sched.h"
 #include "defs.h"
 
+// The policy new processes get: the one chosen with
+// SCHEDULER at build time, until sched_setpolicy().
+#ifdef FCFS
+#define SCHED_DEFAULT SCHED_FCFS
+#endif
+#ifdef PBS
+#define SCHED_DEFAULT SCHED_PBS
+#endif
+#ifdef MLFQ
+#define SCHED_DEFAULT SCHED_MLFQ
+#endif
+#ifdef CFS
+#define SCHED_DEFAULT SCHED_CFS
+#endif
+#ifdef STRIDE
+#define SCHED_DEFAULT SCHED_STRIDE
+#endif
+#ifndef SCHED_DEFAULT
+#define SCHED_DEFAULT SCHED_RR
+#endif
+
+int schedpolicy = SCHED_DEFAULT;
+
 struct cpu cpus[NCPU];
 
-struct proc proc[NPROC];
+// Processes are allocated a few to a page, from pages of
+// their own, and are never given back: once memory is a
+// struct proc it stays one, on procfree while UNUSED. So
+// a stale pointer to a process is always safe to follow,
+// to lock it and check it is still the one wanted, by
+// pid, as lendtickets() and takewakee() do. Their kernel
+// stacks are given back, though, beyond the NPROCKEEP
+// UNUSED processes kept ready for fork().
+struct proc *procs;             // every struct proc, by p->allnext
+static struct proc *procfree;   // the UNUSED ones with a kernel stack, by p->freenext
+static int nprocfree;           // how many
+static struct proc *procbare;   // the UNUSED ones without, by p->freenext
+static char *procpage;          // the page being carved up
+static int procpagefree;        // struct procs left in it
+static int runqorder;           // each rq->heap is 2^runqorder pages
+int nproc;                      // number of struct procs, at most NPROC
+struct spinlock procs_lock;     // guards the above, and kernel stack mappings
+
+// bumped whenever a kernel stack is mapped; see switchin().
+uint kstackgen;
 
 struct proc *initproc;
 
 int nextpid = 1;
 struct spinlock pid_lock;
 
+// Live processes by pid, for getproc(), chained
+// through p->pidnext. Guarded by pid_lock.
+static struct proc *pidhash[NPIDHASH];
+#define PIDHASH(pid) ((pid) % NPIDHASH)
+
+// guards cpu->edfutil, the EDF reservations, and the
+// throttled EDF tasks, by p->dlnext.
+struct spinlock edf_lock;
+static struct proc *edfthrottled;
+
+// A process group with a cpu quota: its processes may
+// use quota percent of all the started cpus' time in each
+// period of QUOTAPERIOD ticks. Once they have, they are
+// parked until the next period. Groups without a quota
+// aren't listed and aren't limited.
+struct pgroup {
+  int pgid;             // 0 if the slot is free
+  int quota;            // percent of all cpus per period
+  uint64 used;          // r_time() cycles used this period
+  uint64 total;         // cycles used since the quota was set
+  int nthrottle;        // periods in which it ran out
+  int throttled;        // out of quota for this period?
+  struct proc *parked;  // processes waiting for the next period
+} pgroups[NPGROUP];
+
+// guards pgroups[]. Acquire after any p->lock.
+struct spinlock pgroup_lock;
+
+// number of groups with a quota, to skip the
+// accounting when there are none.
+int nquota;
+
+// bumped, under pgroup_lock, whenever a group gains or
+// loses its quota, so that processes look up their
+// group again; see pgroupof().
+static uint quotagen = 1;
+
+// may p run on cpu number id?
+#define CANRUN(p, id) (((p)->affinity >> (id)) & 1)
+
 extern void forkret(void);
 static void freeproc(struct proc *p);
+static void setrunnable(struct proc *p);
+static void requeue(struct proc *p, int policy);
+static int runqgrow(int n);
+static struct proc* runqfirst(struct runq *rq);
+static void runqdel(struct runq *rq, struct proc *p);
 
 extern char trampoline[]; // trampoline.S
 
@@ -26,34 +115,130 @@ extern char trampoline[]; // trampoline.S
 // must be acquired before any p->lock.
 struct spinlock wait_lock;
 
-// Allocate a page for each process's kernel stack.
-// Map it high in memory, followed by an invalid
-// guard page.
-void
-proc_mapstacks(pagetable_t kpgtbl) {
-  struct proc *p;
-  
-  for(p = proc; p < &proc[NPROC]; p++) {
-    char *pa = kalloc();
-    if(pa == 0)
-      panic("kalloc");
-    uint64 va = KSTACK((int) (p - proc));
-    kvmmap(kpgtbl, va, (uint64)pa, PGSIZE, PTE_R | PTE_W);
-  }
-}
+// Processes sleeping on a channel are listed in the
+// bucket chan hashes to, so that wakeup() only looks at
+// the few processes that might be sleeping on chan. A
+// bucket's lock must be acquired before any p->lock.
+struct waitq {
+  struct spinlock lock;
+  struct proc *head;  // slept longest
+  struct proc *tail;
+} waitq[NWAITQ];
+
+#define WAITQHASH(chan) ((((uint64)(chan)) >> 3) % NWAITQ)
 
 // initialize the proc table at boot time.
 void
 procinit(void)
 {
-  struct proc *p;
+  struct cpu *c;
+  struct waitq *w;
   
+  initlock(&procs_lock, "procs");
   initlock(&pid_lock, "nextpid");
   initlock(&wait_lock, "wait_lock");
-  for(p = proc; p < &proc[NPROC]; p++) {
-      initlock(&p->lock, "proc");
-      p->kstack = KSTACK((int) (p - proc));
+  initlock(&edf_lock, "edf");
+  initlock(&pgroup_lock, "pgroup");
+  for(c = cpus; c < &cpus[NCPU]; c++){
+      initlock(&c->rq.lock, "runq");
+      c->rq.cpu = c;
+  }
+  for(w = waitq; w < &waitq[NWAITQ]; w++)
+      initlock(&w->lock, "waitq");
+}
+
+// Map a new kernel stack at va, some slot's KSTACK(),
+// and return its physical memory; or 0 if memory is
+// short. Caller must hold procs_lock.
+static uint64
+kstackalloc(uint64 va)
+{
+  char *pa;
+
+  if((pa = kallocpages(KSTACKORDER)) == 0)
+    return 0;
+  if(kvmmapstack(va, (uint64)pa) != 0){
+    kfreepages(pa, KSTACKORDER);
+    return 0;
+  }
+  // another hart may still hold a translation for the
+  // stack that was mapped at va before; each flushes
+  // its TLB before it next runs a process.
+  __sync_fetch_and_add(&kstackgen, 1);
+  return (uint64)pa;
+}
+
+// Unmap UNUSED p's kernel stack and free its memory.
+// Caller must hold procs_lock.
+static void
+kstackfree(struct proc *p)
+{
+  kvmunmapstack(p->kstack);
+  kfreepages((void*)p->kstackpa, KSTACKORDER);
+  p->kstackpa = 0;
+}
+
+// A new struct proc, with its lock and kernel stack,
+// carved from a page of them; or 0 if NPROC exist or
+// memory is short. Caller must hold procs_lock.
+static struct proc*
+procnew(void)
+{
+  struct proc *p;
+  uint64 kstackpa;
+
+  if(nproc >= NPROC || runqgrow(nproc + 1) < 0)
+    return 0;
+  if(procpagefree == 0){
+    if((procpage = kalloc()) == 0)
+      return 0;
+    procpagefree = PGSIZE / sizeof(struct proc);
+  }
+  // the stack goes in slot nproc, below the
+  // stacks of the struct procs made before.
+  if((kstackpa = kstackalloc(KSTACK(nproc))) == 0)
+    return 0;
+
+  p = (struct proc*)procpage;
+  procpage += sizeof(struct proc);
+  procpagefree--;
+  memset(p, 0, sizeof(*p));
+  initlock(&p->lock, "proc");
+  p->kstack = KSTACK(nproc);
+  p->kstackpa = kstackpa;
+
+  // publish p only once it is set up: procs is
+  // walked without procs_lock.
+  p->allnext = procs;
+  __sync_synchronize();
+  procs = p;
+  nproc++;
+  return p;
+}
+
+// The live process with pid, with its lock held;
+// or 0 if there is none.
+static struct proc*
+getproc(int pid)
+{
+  struct proc *p;
+
+  acquire(&pid_lock);
+  for(p = pidhash[PIDHASH(pid)]; p; p = p->pidnext)
+    if(p->pid == pid)
+      break;
+  release(&pid_lock);
+
+  // it may have been freed, and even reused,
+  // before we got its lock.
+  if(p == 0)
+    return 0;
+  acquire(&p->lock);
+  if(p->pid != pid || p->state == UNUSED){
+    release(&p->lock);
+    return 0;
   }
+  return p;
 }
 
 // Must be called with interrupts disabled,
@@ -85,19 +270,40 @@ myproc(void) {
   return p;
 }
 
+// Give p a new pid, and list it in pidhash[].
 int
-allocpid() {
+allocpid(struct proc *p) {
   int pid;
   
   acquire(&pid_lock);
   pid = nextpid;
   nextpid = nextpid + 1;
+  p->pid = pid;
+  p->pidnext = pidhash[PIDHASH(pid)];
+  pidhash[PIDHASH(pid)] = p;
   release(&pid_lock);
 
   return pid;
 }
 
-// Look in the process table for an UNUSED proc.
+// Take p out of pidhash[].
+static void
+freepid(struct proc *p)
+{
+  struct proc **pp;
+
+  acquire(&pid_lock);
+  for(pp = &pidhash[PIDHASH(p->pid)]; *pp; pp = &(*pp)->pidnext){
+    if(*pp == p){
+      *pp = p->pidnext;
+      break;
+    }
+  }
+  release(&pid_lock);
+  p->pidnext = 0;
+}
+
+// Take an UNUSED proc off the free list, or make a new one.
 // If found, initialize state required to run in the kernel,
 // and return with p->lock held.
 // If there are no free procs, or a memory allocation fails, return 0.
@@ -106,19 +312,28 @@ allocproc(void)
 {
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++) {
-    acquire(&p->lock);
-    if(p->state == UNUSED) {
-      goto found;
-    } else {
-      release(&p->lock);
-    }
-  }
-  return 0;
+  acquire(&procs_lock);
+  if((p = procfree) != 0){
+    procfree = p->freenext;
+    nprocfree--;
+  } else if((p = procbare) != 0){
+    if((p->kstackpa = kstackalloc(p->kstack)) != 0)
+      procbare = p->freenext;
+    else
+      p = 0;
+  } else
+    p = procnew();
+  release(&procs_lock);
+  if(p == 0)
+    return 0;
 
-found:
-  p->pid = allocpid();
+  acquire(&p->lock);
+  if(p->state != UNUSED)
+    panic("allocproc");
+  allocpid(p);
   p->state = USED;
+  p->cpu = -1;
+  p->rq = 0;
 
   // Allocate a trapframe page.
   if((p->trapframe = (struct trapframe *)kalloc()) == 0){
@@ -139,26 +354,37 @@ found:
   // which returns to user space.
   memset(&p->context, 0, sizeof(p->context));
   p->context.ra = (uint64)forkret;
-  p->context.sp = p->kstack + PGSIZE;
+  p->context.sp = p->kstack + KSTACKSIZE;
 
   p->ctime = ticks;       // setting create time of the process (Q2)
   p->rtime = 0;           // initializing run time of the process to 0 (Q2)
   p->etime = 0;           // initializing end time of the process to 0 (Q2)
 
-  p->priority = 60;       // set the default priority  (Q2 - PBS)
+  p->ps.priority = 60;    // set the default priority  (Q2 - PBS)
   p->niceness = 5;
 
   p->stime = 0;
+  p->wtime = 0;
+  p->stamp = r_time();
   p->num_of_runs = 0;
-
-  // #ifdef MLFQ
-  // p->num_of_runs = 0;
-  // p->sched_time = 0;
-  // p->queue = 0;
-
-  // for (int i = 0; i < 5; i++)
-  //   p->ticks[i] = 0;
-  // #endif
+  p->lastcpu = -1;
+  p->nvcsw = 0;
+  p->nivcsw = 0;
+  p->nmigrate = 0;
+
+  p->affinity = ~0;       // any cpu
+  p->wakee = 0;
+  p->pgid = p->pid;       // a group of its own, until fork() says otherwise
+  p->qgen = 0;            // not looked up yet, see pgroupof()
+  p->policy = schedpolicy;
+  p->ps.level = 0;        // new processes start at the top (MLFQ)
+  p->ps.vruntime = 0;
+  p->ps.pass = 0;
+  p->borrowed = 0;
+  p->lentto = 0;
+  p->ps.slice = 0;
+  for (int i = 0; i < NMLFQ; i++)
+    p->qticks[i] = 0;
   
   return p;
 }
@@ -176,6 +402,8 @@ freeproc(struct proc *p)
     proc_freepagetable(p->pagetable, p->sz);
   p->pagetable = 0;
   p->sz = 0;
+  if(p->pid)
+    freepid(p);
   p->pid = 0;
   p->parent = 0;
   p->name[0] = 0;
@@ -187,7 +415,21 @@ freeproc(struct proc *p)
   p->ctime = 0;                   // Create time of the process 
   p->rtime = 0;                   // Run time of the process 
   p->etime = 0;                   // End time of the process 
-  p->priority = 0;                // Process priority for PBS
+  p->ps.priority = 0;             // Process priority for PBS
+
+  // p has stopped running for good, so nothing
+  // is on its kernel stack.
+  acquire(&procs_lock);
+  if(nprocfree < NPROCKEEP){
+    p->freenext = procfree;
+    procfree = p;
+    nprocfree++;
+  } else {
+    kstackfree(p);
+    p->freenext = procbare;
+    procbare = p;
+  }
+  release(&procs_lock);
 }
 
 // Create a user page table for a given process,
@@ -266,7 +508,7 @@ userinit(void)
   safestrcpy(p->name, "initcode", sizeof(p->name));
   p->cwd = namei("/");
 
-  p->state = RUNNABLE;
+  setrunnable(p);
 
   release(&p->lock);
 }
@@ -276,14 +518,16 @@ userinit(void)
 int
 growproc(int n)
 {
-  uint sz;
+  uint64 sz;
   struct proc *p = myproc();
 
   sz = p->sz;
   if(n > 0){
-    if((sz = uvmalloc(p->pagetable, sz, sz + n)) == 0) {
+    // only reserve the address space: pages are
+    // allocated when first touched, by lazyfault().
+    if(sz + n > TRAPFRAME)
       return -1;
-    }
+    sz += n;
   } else if(n < 0){
     sz = uvmdealloc(p->pagetable, sz, sz + n);
   }
@@ -291,6 +535,53 @@ growproc(int n)
   return 0;
 }
 
+// A parent's children, and its zombie children, are
+// each on a list threaded through p->snext/p->sprev,
+// so wait() and exit() only look at a process's own
+// children. Caller must hold wait_lock.
+static void
+childadd(struct proc **list, struct proc *p)
+{
+  p->sprev = 0;
+  p->snext = *list;
+  if(*list)
+    (*list)->sprev = p;
+  *list = p;
+}
+
+static void
+childdel(struct proc **list, struct proc *p)
+{
+  if(p->sprev)
+    p->sprev->snext = p->snext;
+  else
+    *list = p->snext;
+  if(p->snext)
+    p->snext->sprev = p->sprev;
+  p->snext = p->sprev = 0;
+}
+
+// Move every process on list *from onto list *to,
+// as children of parent. Returns 1 if there were any.
+static int
+childsplice(struct proc **from, struct proc **to, struct proc *parent)
+{
+  struct proc *pp, *tail = 0;
+
+  if(*from == 0)
+    return 0;
+  for(pp = *from; pp; pp = pp->snext){
+    pp->parent = parent;
+    tail = pp;
+  }
+  tail->snext = *to;
+  if(*to)
+    (*to)->sprev = tail;
+  *to = *from;
+  *from = 0;
+  return 1;
+}
+
 // Create a new process, copying the parent.
 // Sets up child kernel stack to return as if from fork() system call.
 int
@@ -319,6 +610,20 @@ fork(void)
   //** copying tracemask **//
   np->tracemask = p->tracemask;
 
+  // the child starts where the parent is, so forking
+  // doesn't buy more CPU time (CFS).
+  np->ps.vruntime = p->ps.vruntime;
+  np->ps.pass = p->ps.pass;
+  np->policy = p->policy;
+  np->affinity = p->affinity;
+  np->pgid = p->pgid;
+
+  // EDF reservations are not inherited.
+  if(p->policy == SCHED_EDF){
+    np->policy = schedpolicy;
+    np->affinity = p->dlmask;
+  }
+
   // Cause fork to return 0 in the child.
   np->trapframe->a0 = 0;
 
@@ -336,10 +641,11 @@ fork(void)
 
   acquire(&wait_lock);
   np->parent = p;
+  childadd(&p->children, np);
   release(&wait_lock);
 
   acquire(&np->lock);
-  np->state = RUNNABLE;
+  setrunnable(np);
   release(&np->lock);
 
   return pid;
@@ -350,14 +656,10 @@ fork(void)
 void
 reparent(struct proc *p)
 {
-  struct proc *pp;
-
-  for(pp = proc; pp < &proc[NPROC]; pp++){
-    if(pp->parent == p){
-      pp->parent = initproc;
-      wakeup(initproc);
-    }
-  }
+  childsplice(&p->children, &initproc->children, initproc);
+  // init may be waiting for any child to exit.
+  if(childsplice(&p->zombies, &initproc->zombies, initproc))
+    wakeup(initproc);
 }
 
 // Exit the current process.  Does not return.
@@ -385,6 +687,10 @@ exit(int status)
   end_op();
   p->cwd = 0;
 
+  // give up any EDF reservation.
+  if(p->policy == SCHED_EDF)
+    setdeadline(0, 0, 0);
+
   acquire(&wait_lock);
 
   // Give any children to init.
@@ -397,6 +703,8 @@ exit(int status)
 
   p->xstate = status;
   p->state = ZOMBIE;
+  childdel(&p->parent->children, p);
+  childadd(&p->parent->zombies, p);
 
   p->etime = ticks;         //setting end time of the process (Q2)
 
@@ -413,40 +721,32 @@ int
 wait(uint64 addr)
 {
   struct proc *np;
-  int havekids, pid;
+  int pid;
   struct proc *p = myproc();
 
   acquire(&wait_lock);
 
   for(;;){
-    // Scan through table looking for exited children.
-    havekids = 0;
-    for(np = proc; np < &proc[NPROC]; np++){
-      if(np->parent == p){
-        // make sure the child isn't still in exit() or swtch().
-        acquire(&np->lock);
-
-        havekids = 1;
-        if(np->state == ZOMBIE){
-          // Found one.
-          pid = np->pid;
-          if(addr != 0 && copyout(p->pagetable, addr, (char *)&np->xstate,
-                                  sizeof(np->xstate)) < 0) {
-            release(&np->lock);
-            release(&wait_lock);
-            return -1;
-          }
-          freeproc(np);
-          release(&np->lock);
-          release(&wait_lock);
-          return pid;
-        }
+    // Any exited children?
+    if((np = p->zombies) != 0){
+      // make sure the child isn't still in exit() or swtch().
+      acquire(&np->lock);
+      pid = np->pid;
+      if(addr != 0 && copyout(p->pagetable, addr, (char *)&np->xstate,
+                              sizeof(np->xstate)) < 0) {
         release(&np->lock);
+        release(&wait_lock);
+        return -1;
       }
+      childdel(&p->zombies, np);
+      freeproc(np);
+      release(&np->lock);
+      release(&wait_lock);
+      return pid;
     }
 
     // No point waiting if we don't have any children.
-    if(!havekids || p->killed){
+    if(p->children == 0 || p->killed){
       release(&wait_lock);
       return -1;
     }
@@ -459,47 +759,50 @@ wait(uint64 addr)
 // Wait for a child process to exit and return its pid.
 // Return -1 if this process has no children.
 int
-waitx(uint64 addr, uint* rtime, uint* wtime)
+waitx(uint64 addr, uint* wtime, uint* rtime, uint64 psaddr)
 {
   struct proc *np;
-  int havekids, pid;
+  int pid;
   struct proc *p = myproc();
 
   acquire(&wait_lock);
 
   for(;;){
-    // Scan through table looking for exited children.
-    havekids = 0;
-    for(np = proc; np < &proc[NPROC]; np++){
-      if(np->parent == p){
-        // make sure the child isn't still in exit() or swtch().
-        acquire(&np->lock);
-
-        havekids = 1;
-        if(np->state == ZOMBIE){
-          // Found one.
-          pid = np->pid;
-
-          *rtime = np->pid;                               // running time of the process (Q2)
-          *wtime = np->etime - np->ctime - np->rtime;     //wait time of the process (Q2)
-
-          if(addr != 0 && copyout(p->pagetable, addr, (char *)&np->xstate,
-                                  sizeof(np->xstate)) < 0) {
-            release(&np->lock);
-            release(&wait_lock);
-            return -1;
-          }
-          freeproc(np);
-          release(&np->lock);
-          release(&wait_lock);
-          return pid;
-        }
+    // Any exited children?
+    if((np = p->zombies) != 0){
+      // make sure the child isn't still in exit() or swtch().
+      acquire(&np->lock);
+      pid = np->pid;
+
+      *rtime = np->rtime / TICKCYCLES;                // running time of the process (Q2)
+      *wtime = np->etime - np->ctime - *rtime;        //wait time of the process (Q2)
+
+      struct procstat ps;
+      ps.rtime = *rtime;
+      ps.wtime = np->wtime / TICKCYCLES;
+      ps.stime = np->stime / TICKCYCLES;
+      ps.nrun = np->num_of_runs;
+      ps.nvcsw = np->nvcsw;
+      ps.nivcsw = np->nivcsw;
+      ps.nmigrate = np->nmigrate;
+
+      if((addr != 0 && copyout(p->pagetable, addr, (char *)&np->xstate,
+                               sizeof(np->xstate)) < 0) ||
+         (psaddr != 0 && copyout(p->pagetable, psaddr, (char *)&ps,
+                                 sizeof(ps)) < 0)) {
         release(&np->lock);
+        release(&wait_lock);
+        return -1;
       }
+      childdel(&p->zombies, np);
+      freeproc(np);
+      release(&np->lock);
+      release(&wait_lock);
+      return pid;
     }
 
     // No point waiting if we don't have any children.
-    if(!havekids || p->killed){
+    if(p->children == 0 || p->killed){
       release(&wait_lock);
       return -1;
     }
@@ -509,415 +812,1669 @@ waitx(uint64 addr, uint* rtime, uint* wtime)
   }
 }
 
-void
-update_time()
+// p's run time in ticks, counting the time it has been
+// running for now, if it is. Reads r_time(), so the
+// value is exact, not a count of the ticks p was
+// running at.
+static uint
+runticks(struct proc *p)
 {
-  struct proc* p;
-  for (p = proc; p < &proc[NPROC]; p++) {
-    acquire(&p->lock);
-    if (p->state == RUNNING) {
-      p->rtime++;
-    }
-    if(p->state == SLEEPING)
-    {
-      p->stime++;
-    }
-    release(&p->lock); 
-  }
+  uint64 rtime = p->rtime;
+
+  if(p->state == RUNNING)
+    rtime += r_time() - p->stamp;
+  return rtime / TICKCYCLES;
 }
 
+// Set process pid's priority, from 0 (highest) to 100.
+// Returns the old priority, or -1 if there is no such
+// process or new_priority is out of range.
 int setpriority(int new_priority, int pid)
 {
   int old_priority = -1;
 
-  // //acquire process table lock
-  //acquire(&ptable.lock);
-
-  //scan through process table
   struct proc* p;
-  for (p = proc; p < &proc[NPROC]; p++)
+  if(new_priority < 0 || new_priority > 100)
+    return -1;
+  if ((p = getproc(pid)) != 0)
   {
-    //int old_priority;
-    acquire(&p->lock);
-    if (p->pid == pid)
-    {
-      //store old priority and change the priority
-      old_priority = p->priority;
-      p->priority = new_priority;
-      p->niceness = 5;
-      //printf("p: %d\n", p->niceness);
-    }
+    //store old priority and change the priority
+    old_priority = p->ps.priority;
+    p->ps.priority = new_priority;
+    p->niceness = 5;
+
+    // a queued process must move to its new place.
+    requeue(p, p->policy);
     release(&p->lock);
   }
-  // //release process table lock
-  //release(&ptable.lock);
 
   //output old priority
   return old_priority;
-  //return pid;
 }
 
-
-// Per-CPU process scheduler.
-// Each CPU calls scheduler() after setting itself up.
-// Scheduler never returns.  It loops, doing:
-//  - choose a process to run.
-//  - swtch to start running that process.
-//  - eventually that process transfers control
-//    via swtch back to the scheduler.
-void
-scheduler(void)
+// Switch process pid to policy, or every process and all
+// future ones if pid is 0. A policy of -1 changes nothing.
+// Returns the previous policy, or -1 if there is no such
+// policy or process.
+int
+setpolicy(int policy, int pid)
 {
   struct proc *p;
+  int old = -1;
 
-  struct cpu *c = mycpu();
-  //struct proc *minP;
-  c->proc = 0;
+  // EDF needs the parameters sched_setdeadline() takes.
+  if(policy < -1 || policy >= NSCHED || policy == SCHED_EDF)
+    return -1;
 
-  #ifdef FCFS
-  int sched_condition = 0;
-  #endif
+  if(pid == 0){
+    old = schedpolicy;
+    if(policy < 0)
+      return old;
+    schedpolicy = policy;
+  }
 
-  #ifdef PBS
-  int priority_condition = 0;
-  #endif
+  if(pid != 0){
+    if((p = getproc(pid)) == 0)
+      return -1;
+    old = p->policy;
+    // only the task itself can leave EDF.
+    if(policy >= 0 && p->policy != SCHED_EDF)
+      requeue(p, policy);
+    release(&p->lock);
+    return old;
+  }
 
-  // #ifdef MLFQ
-  // p = 0;
-  // #endif
+  for(p = procs; p; p = p->allnext){
+    acquire(&p->lock);
+    if(p->state != UNUSED && p->policy != SCHED_EDF)
+      requeue(p, policy);
+    release(&p->lock);
+  }
+  return old;
+}
 
-  for(;;)
-  {
-    // Avoid deadlock by ensuring that devices can interrupt.
-    intr_on();
+// Restrict process pid, or the caller if pid is 0, to
+// the cpus whose bits are set in mask. It moves off
+// any other cpu at once. Returns -1 if there is no
+// such process, or mask has no started cpu.
+int
+setaffinity(int pid, uint mask)
+{
+  struct proc *p;
+  struct runq *rq;
+  struct cpu *c;
+  int ok = 0;
+
+  for(c = cpus; c < &cpus[NCPU]; c++)
+    if(c->started && ((mask >> (c - cpus)) & 1))
+      ok = 1;
+  if(!ok)
+    return -1;
 
-    #ifdef RR
-
-    //printf("RR\n");
-
-    for(p = proc; p < &proc[NPROC]; p++) 
-    {
-      acquire(&p->lock);
-      if(p->state == RUNNABLE) 
-      {
-        // Switch to chosen process.  It is the process's job
-        // to release its lock and then reacquire it
-        // before jumping back to us.
-        p->state = RUNNING;
-        c->proc = p;
-        //printf("pname %s, pid %d, rtime %d ctime %d\n", p->name, p->pid, p->rtime, p->ctime);
-        swtch(&c->context, &p->context);
-
-        // Process is done running for now.
-        // It should have changed its p->state before coming back.
-        c->proc = 0;
-      }
-      release(&p->lock);
-    }
-    #else
-    #ifdef FCFS
-
-    //printf("FCFS\n");
-
-    struct proc *scheduled_process = 0;
-
-    for(p = proc; p < &proc[NPROC]; p++)
-    {
-      acquire(&p->lock);
-
-      if(p->state == RUNNABLE)
-      {
-        if(scheduled_process == 0)
-        {
-          scheduled_process = p;
-        }
-        else
-        {
-          sched_condition = p->ctime < scheduled_process->ctime;
-
-          if(sched_condition)
-          {
-            release(&scheduled_process->lock);
-            scheduled_process = p;
-          }
-          else
-          {
-            release(&p->lock);
-          }
-        }
-      }
-      else
-      {
-        release(&p->lock);
-      }
-    }
-      
-    if(scheduled_process != 0)
-    {
-      scheduled_process->state = RUNNING;
-      c->proc = scheduled_process;
-      swtch(&c->context, &scheduled_process->context);
+  if(pid == 0)
+    pid = myproc()->pid;
+  if((p = getproc(pid)) == 0)
+    return -1;
+  if(p->policy == SCHED_EDF){
+    // pinned where its reservation is.
+    release(&p->lock);
+    return -1;
+  }
 
-      // Process is done running for now.
-      // It should have changed its p->state before coming back.
-      c->proc = 0;
-      release(&scheduled_process->lock);
-  
-    }
+  // stealing cpus read p->affinity under rq->lock.
+  if((rq = p->rq) != 0)
+    acquire(&rq->lock);
+  p->affinity = mask;
+  if(rq && p->rq == rq && !CANRUN(p, rq->cpu - cpus)){
+    runqdel(rq, p);
+    release(&rq->lock);
+    setrunnable(p);
+  } else if(rq){
+    release(&rq->lock);
+  }
 
-    #else
-    #ifdef PBS
+  // if p is running where it no longer may,
+  // make it yield, which moves it.
+  if(p->state == RUNNING && !CANRUN(p, p->cpu)){
+    c = &cpus[p->cpu];
+    c->resched = 1;
+    if(c != mycpu())
+      ipi(p->cpu);
+  }
+  release(&p->lock);
+  return 0;
+}
 
-    struct proc *low_priority = 0;
-    
-    // Loop over process table looking for process to run.
-    //acquire(&ptable.lock);
-    for(p = proc; p < &proc[NPROC]; p++)
-    {
-      acquire(&p->lock);
-
-      if(p->state == RUNNABLE)
-      {
-        //niceness = Int( ticks in sleeping state/ticks in running+sleeping state)*10
-        int niceness = ((p->stime)/((p->rtime) + (p->stime)))*10;
-
-        p->niceness = niceness;
-
-        if((p->rtime + p->stime)==0 || p->stime == 0)
-        {
-          p->niceness = 0;
-        }
-
-        // if((p->rtime + p->stime) == p->stime)
-        // {
-        //   p->niceness = 10;
-        // }
-        
-        // DP = max(0, min(SP − niceness + 5, 100))
-        int dp = p->priority - p->niceness + 5;
-
-        if (dp > 100)
-        {
-          dp = 100;
-        }
-
-        if (dp < 0)
-        {
-          dp = 0;
-        }
-
-        p->dynamic_priority = dp;
-
-        if(low_priority == 0)   //for the first process
-        {
-          low_priority = p;
-        }
-        else                    // for every process after the first
-        {
-          priority_condition = p->dynamic_priority < low_priority->dynamic_priority;
-
-          if(priority_condition)
-          {
-            release(&low_priority->lock);
-            low_priority = p;
-          }
-          else
-          {
-            release(&p->lock);
-          }
-        }
-      }
-      else
-      {
-        release(&p->lock);
-      }
-    }
-      
-    if(low_priority != 0)
-    {
-      low_priority->num_of_runs += 1;
-      low_priority->state = RUNNING;
-      c->proc = low_priority;
-      
-      //printf("pname %s, pid %d, rtime %d ctime %d\n", scheduled_process->name, scheduled_process->pid, scheduled_process->rtime, scheduled_process->ctime);
-      swtch(&c->context, &low_priority->context);
+// The cpus process pid, or the caller if pid is 0, may
+// run on, as a mask of started cpus; or -1 if there is
+// no such process.
+int
+getaffinity(int pid)
+{
+  struct proc *p;
+  struct cpu *c;
+  uint online = 0;
+  int mask = -1;
+
+  for(c = cpus; c < &cpus[NCPU]; c++)
+    if(c->started)
+      online |= 1 << (c - cpus);
+
+  if(pid == 0)
+    pid = myproc()->pid;
+  if((p = getproc(pid)) != 0){
+    mask = p->affinity & online;
+    release(&p->lock);
+  }
+  return mask;
+}
 
-      // Process is done running for now.
-      // It should have changed its p->state before coming back.
-      c->proc = 0;
-      release(&low_priority->lock);
-  
-    }
+// Make the caller a real-time EDF task that needs runtime
+// ticks of cpu every period ticks, each within deadline
+// ticks of the period's start; or, if runtime is 0, a
+// normal process again. Admission control puts it on the
+// cpu with the least reserved whose EDF tasks, with it,
+// need at most EDFUTIL percent of it, by runtime/deadline,
+// and pins it there. Returns -1 if no cpu has room.
+int
+setdeadline(int runtime, int period, int deadline)
+{
+  struct proc *p = myproc();
+  struct cpu *c, *best = 0;
+  int util = 0;
 
+  if(runtime < 0 || (runtime > 0 && (deadline < runtime || period < deadline)))
+    return -1;
+  if(runtime > 0)
+    util = runtime * 1000 / deadline;
+
+  acquire(&edf_lock);
+  if(p->policy == SCHED_EDF)
+    cpus[p->dlcpu].edfutil -= p->dlutil;
+  if(runtime > 0){
+    for(c = cpus; c < &cpus[NCPU]; c++){
+      if(!c->started || c->edfutil + util > EDFUTIL * 10)
+        continue;
+      if(best == 0 || c->edfutil < best->edfutil)
+        best = c;
+    }
+    if(best == 0){
+      // keep the reservation p had, if any.
+      if(p->policy == SCHED_EDF)
+        cpus[p->dlcpu].edfutil += p->dlutil;
+      release(&edf_lock);
+      return -1;
+    }
+    best->edfutil += util;
+  }
+  release(&edf_lock);
 
-    // #else
-    // #ifdef MLFQ
-
-    // for (p = proc; p < &proc[NPROC]; p++)
-    // {
-    //   acquire(&p->lock);
-    //   if (p->state == RUNNABLE && p == 0)    
-    //   {
-    //     pushback(&mlfq[0], p);    //puting process into highest priority queue 
-    //     p->queue = 0;
-    //     p->sched_time = ticks;    // setting scheduled time
-    //   }
-    // }
-    // struct proc *toRun = 0;
-    
-    // for (int i = 0; i < 5; i++)
-    // {
-    //   if (size(&mlfq[i]) > 0)
-    //   {
-    //     toRun = mlfq[i].que[mlfq[i].start];
+  acquire(&p->lock);
+  if(runtime > 0){
+    if(p->policy != SCHED_EDF)
+      p->dlmask = p->affinity;
+    p->ps.dlruntime = runtime;
+    p->ps.dlperiod = period;
+    p->ps.dldeadline = deadline;
+    edfrefill(&p->ps, ticks);
+    p->dlcpu = best - cpus;
+    p->dlutil = util;
+    p->affinity = 1 << p->dlcpu;
+    p->policy = SCHED_EDF;
+  } else if(p->policy == SCHED_EDF){
+    p->affinity = p->dlmask;
+    p->policy = schedpolicy;
+  }
+  // move to the reserved cpu at the next trap.
+  if(!CANRUN(p, cpuid()))
+    mycpu()->resched = 1;
+  release(&p->lock);
+  return 0;
+}
 
-    //     if (toRun == 0)
-    //       continue;
+// The quota group pgid, or 0.
+// Caller must hold pgroup_lock.
+static struct pgroup*
+pgroupget(int pgid)
+{
+  struct pgroup *g;
 
-    //    if (toRun->state == RUNNABLE)
-    //       break;
-    //     else          
-    //       deletefront(&mlfq[i]);      // process 
-    //   }
-    // }
-    // if (toRun != 0 && toRun->state == RUNNABLE)   //if a process to run was found
-    // {
-    //     toRun->num_of_runs += 1;
-    //     toRun->sched_time = ticks;
+  for(g = pgroups; g < &pgroups[NPGROUP]; g++)
+    if(g->pgid == pgid)
+      return g;
+  return 0;
+}
 
-    //     c->proc = toRun;
-    //     toRun->state = RUNNING;
+// Cycles a group with quota percent may use per period.
+static uint64
+quotabudget(int quota)
+{
+  struct cpu *c;
+  uint64 ncpu = 0;
 
-    //     swtch(&c->context, &toRun->context);
+  for(c = cpus; c < &cpus[NCPU]; c++)
+    if(c->started)
+      ncpu++;
+  return ncpu * QUOTAPERIOD * TICKCYCLES / 100 * quota;
+}
 
-    //     if (toRun->state == SLEEPING)
-    //     {
-    //       struct proc * del = mlfq[p->queue].que[mlfq[p->queue].start];
-    //       deletefront(&mlfq[p->queue]);
-    //       pushback(&mlfq[p->queue], del);
-    //     }
+// p's quota group, or 0 if its group has no quota. The
+// answer is cached in p, and only looked up again, under
+// pgroup_lock, once quotagen shows that a group's quota
+// was set or lifted since; so processes in groups without
+// a quota don't take pgroup_lock to switch or tick. A
+// cached group may have been freed just now: callers
+// check g->pgid under pgroup_lock before using it.
+// Caller must hold p->lock.
+static struct pgroup*
+pgroupof(struct proc *p)
+{
+  if(p->qgen != quotagen){
+    acquire(&pgroup_lock);
+    p->pgroup = pgroupget(p->pgid);
+    p->qgen = quotagen;
+    release(&pgroup_lock);
+  }
+  return p->pgroup;
+}
 
-    //     c->proc = 0;
-    // }
+// Charge cycles that p has run to its group's quota.
+// Caller must hold p->lock.
+static void
+quotacharge(struct proc *p, uint64 cycles)
+{
+  struct pgroup *g;
+
+  if((g = pgroupof(p)) == 0)
+    return;
+  acquire(&pgroup_lock);
+  if(g->pgid == p->pgid){
+    g->used += cycles;
+    g->total += cycles;
+  }
+  release(&pgroup_lock);
+}
 
-    // release(&p->lock);
+// Called from the timer tick for p, running on this cpu:
+// has p's group used up its quota for this period, with
+// what p has run since it was switched in? If so it must
+// yield, and it will be parked. EDF tasks are exempt,
+// they have their own reservation.
+static int
+quotatick(struct proc *p)
+{
+  struct pgroup *g;
+  int out = 0;
 
-    //#endif
-    #endif
+  if(p->policy == SCHED_EDF || (g = pgroupof(p)) == 0)
+    return 0;
+  acquire(&pgroup_lock);
+  if(g->pgid == p->pgid){
+    if(!g->throttled && g->used + (r_time() - p->stamp) >= quotabudget(g->quota)){
+      g->throttled = 1;
+      g->nthrottle++;
+    }
+    out = g->throttled;
+  }
+  release(&pgroup_lock);
+  return out;
+}
 
-    #endif
-    #endif
+// p, RUNNABLE, was about to run. If its group is out of
+// quota, park p until the next period and return 1.
+// Caller must hold p->lock.
+static int
+quotapark(struct proc *p)
+{
+  struct pgroup *g;
+  int parked = 0;
 
+  if(p->policy == SCHED_EDF || (g = pgroupof(p)) == 0)
+    return 0;
+  acquire(&pgroup_lock);
+  if(g->pgid == p->pgid && g->throttled){
+    p->gnext = g->parked;
+    g->parked = p;
+    parked = 1;
   }
+  release(&pgroup_lock);
+  return parked;
 }
 
-
-// Switch to scheduler.  Must hold only p->lock
-// and have changed proc->state. Saves and restores
-// intena because intena is a property of this
-// kernel thread, not this CPU. It should
-// be proc->intena and proc->noff, but that would
-// break in the few places where a lock is held but
-// there's no process.
+// Called from clockintr() every QUOTAPERIOD ticks: a new
+// period, so groups' quotas are fresh and their parked
+// processes can run again.
 void
-sched(void)
+quotaperiod(void)
 {
-  int intena;
-  struct proc *p = myproc();
-
-  if(!holding(&p->lock))
-    panic("sched p->lock");
-  if(mycpu()->noff != 1)
-    panic("sched locks");
-  if(p->state == RUNNING)
-    panic("sched running");
-  if(intr_get())
-    panic("sched interruptible");
+  struct pgroup *g;
+  struct proc *p, *list = 0, *next;
+
+  if(nquota == 0)
+    return;
+  acquire(&pgroup_lock);
+  for(g = pgroups; g < &pgroups[NPGROUP]; g++){
+    g->used = 0;
+    g->throttled = 0;
+    while((p = g->parked) != 0){
+      g->parked = p->gnext;
+      p->gnext = list;
+      list = p;
+    }
+  }
+  release(&pgroup_lock);
 
-  intena = mycpu()->intena;
-  swtch(&p->context, &mycpu()->context);
-  mycpu()->intena = intena;
+  // nobody else can find a parked process, so
+  // the list is ours to walk without pgroup_lock.
+  for(p = list; p; p = next){
+    next = p->gnext;
+    acquire(&p->lock);
+    setrunnable(p);
+    release(&p->lock);
+  }
 }
 
-// Give up the CPU for one scheduling round.
-void
-yield(void)
+// Put process pid, or the caller if pid is 0, in process
+// group pgid, or a new group of its own if pgid is 0.
+// Returns -1 if there is no such process.
+int
+setpgid(int pid, int pgid)
 {
-  struct proc *p = myproc();
-  acquire(&p->lock);
-  p->state = RUNNABLE;
-  sched();
+  struct proc *p;
+
+  if(pid == 0)
+    pid = myproc()->pid;
+  if(pgid == 0)
+    pgid = pid;
+  if((p = getproc(pid)) == 0)
+    return -1;
+  p->pgid = pgid;
+  p->qgen = 0;    // look its group up again
   release(&p->lock);
+  return 0;
 }
 
-// A fork child's very first scheduling by scheduler()
-// will swtch to forkret.
-void
-forkret(void)
+// The process group of process pid, or of the caller
+// if pid is 0; or -1 if there is no such process.
+int
+getpgid(int pid)
 {
-  static int first = 1;
-
-  // Still holding p->lock from scheduler.
-  release(&myproc()->lock);
+  struct proc *p;
+  int pgid = -1;
 
-  if (first) {
-    // File system initialization must be run in the context of a
-    // regular process (e.g., because it calls sleep), and thus cannot
-    // be run from main().
-    first = 0;
-    fsinit(ROOTDEV);
+  if(pid == 0)
+    return myproc()->pgid;
+  if((p = getproc(pid)) != 0){
+    pgid = p->pgid;
+    release(&p->lock);
+  }
+  return pgid;
+}
+
+// Limit process group pgid to quota percent of all the
+// cpus, or lift its limit if quota is 0. Returns -1 if
+// the quota is out of range or NPGROUP groups already
+// have one.
+int
+setquota(int pgid, int quota)
+{
+  struct pgroup *g;
+  struct proc *p, *list = 0, *next;
+
+  if(pgid <= 0 || quota < 0 || quota > 100)
+    return -1;
+
+  acquire(&pgroup_lock);
+  if((g = pgroupget(pgid)) == 0){
+    if(quota == 0 || (g = pgroupget(0)) == 0){
+      release(&pgroup_lock);
+      return quota == 0 ? 0 : -1;
+    }
+    g->pgid = pgid;
+    g->used = g->total = 0;
+    g->nthrottle = 0;
+    g->throttled = 0;
+    g->parked = 0;
+    nquota++;
+    quotagen++;
+  }
+  g->quota = quota;
+  if(quota == 0){
+    g->pgid = 0;
+    list = g->parked;
+    g->parked = 0;
+    nquota--;
+    quotagen++;
+  }
+  release(&pgroup_lock);
+
+  for(p = list; p; p = next){
+    next = p->gnext;
+    acquire(&p->lock);
+    setrunnable(p);
+    release(&p->lock);
+  }
+  return 0;
+}
+
+// Report process group pgid's quota, as a percent of all
+// the cpus, and store the ticks its processes have used
+// since the quota was set in *rtime, and the number of
+// periods it ran out in *nthrottle. Returns -1 if pgid
+// has no quota.
+int
+quotastat(int pgid, uint *rtime, uint *nthrottle)
+{
+  struct pgroup *g;
+  int quota = -1;
+
+  acquire(&pgroup_lock);
+  if(pgid > 0 && (g = pgroupget(pgid)) != 0){
+    quota = g->quota;
+    *rtime = g->total / TICKCYCLES;
+    *nthrottle = g->nthrottle;
+  }
+  release(&pgroup_lock);
+  return quota;
+}
+
+// Recompute p's dynamic priority from its static priority
+// and the share of its life it has spent sleeping.
+// Caller must hold p->lock.
+static int
+pbs_priority(struct proc *p)
+{
+  p->dynamic_priority = pbsprio(p->ps.priority, p->rtime, p->stime, &p->niceness);
+  return p->dynamic_priority;
+}
+
+// p's stride tickets: the lower its priority number,
+// the more, from 1 at priority 100 to 101 at 0; plus
+// any lent to it by clients waiting on it. At most
+// STRIDE1, so that every tick advances p's pass.
+static int
+tickets(struct proc *p)
+{
+  int n = stridetickets(p->ps.priority) + p->borrowed;
+
+  if(n > STRIDE1)
+    n = STRIDE1;
+  return n;
+}
+
+// p is about to block reading a pipe that server, whose
+// pid is pid, writes. Lend server p's tickets until p
+// wakes, so that a server busy with clients' requests
+// runs with their share of the cpu, not just its own
+// (STRIDE).
+void
+lendtickets(struct proc *server, int pid)
+{
+  struct proc *p = myproc();
+
+  if(server == 0 || server == p || p->policy != SCHED_STRIDE)
+    return;
+  acquire(&server->lock);
+  if(server->pid == pid && server->state != UNUSED && server->state != ZOMBIE){
+    p->lent = tickets(p);
+    p->lentto = server;
+    p->lentpid = pid;
+    server->borrowed += p->lent;
+  }
+  release(&server->lock);
+}
+
+// Take back the tickets lendtickets() lent, if the
+// server hasn't exited since.
+void
+returntickets(void)
+{
+  struct proc *p = myproc();
+  struct proc *server = p->lentto;
+
+  if(server == 0)
+    return;
+  acquire(&server->lock);
+  if(server->pid == p->lentpid)
+    server->borrowed -= p->lent;
+  release(&server->lock);
+  p->lentto = 0;
+}
+
+#define RQKEYMASK ((1L << 56) - 1)
+
+// Sort keys for rq->heap, from policy.h; the smallest
+// key runs first. They must fit in 56 bits, see runqkey().
+// Caller must hold p->lock and rq->lock.
+
+static uint64
+rr_key(struct runq *rq, struct proc *p)
+{
+  return rrkey(&rq->pq) & RQKEYMASK;
+}
+
+static uint64
+fcfs_key(struct runq *rq, struct proc *p)
+{
+  return fcfskey(&rq->pq, p->ctime);
+}
+
+static uint64
+pbs_key(struct runq *rq, struct proc *p)
+{
+  return pbskey(&rq->pq, pbs_priority(p));
+}
+
+static uint64
+cfs_key(struct runq *rq, struct proc *p)
+{
+  return cfskey(&rq->pq, &p->ps) & RQKEYMASK;
+}
+
+static uint64
+edf_key(struct runq *rq, struct proc *p)
+{
+  return edfkey(&rq->pq, &p->ps, ticks);
+}
+
+static uint64
+stride_key(struct runq *rq, struct proc *p)
+{
+  return stridekey(&rq->pq, &p->ps) & RQKEYMASK;
+}
+
+// Timer tick handlers, from policy.h: charge a tick to
+// p, running on this cpu, and return 1 if p should give
+// up the cpu. slice is the policy's time slice, in ticks.
+// Caller must hold p->lock, since requeue() and
+// setpolicy() read the fields these change.
+
+static int
+slice_tick(struct proc *p, int slice)
+{
+  return slicetick(&p->ps, slice);
+}
+
+static int
+mlfq_tick(struct proc *p, int slice)
+{
+  uint waiting;
+
+  p->qticks[p->ps.level]++;
+  push_off();
+  waiting = mycpu()->rq.mlfqmask;
+  pop_off();
+  return mlfqtick(&p->ps, slice, waiting);
+}
+
+// compared with the process first in line here.
+static int
+cfs_tick(struct proc *p, int slice)
+{
+  struct runq *rq;
+  struct proc *first;
+  int preempt;
+
+  push_off();
+  rq = &mycpu()->rq;
+  if(rq->n == 0)
+    preempt = cfstick(&p->ps, slice, 0);
+  else {
+    acquire(&rq->lock);
+    first = runqfirst(rq);
+    if(first && first->policy != SCHED_CFS)
+      first = 0;
+    preempt = cfstick(&p->ps, slice, first ? &first->ps : 0);
+    release(&rq->lock);
+  }
+  pop_off();
+  return preempt;
+}
+
+// with p's own tickets and those lent to it.
+static int
+stride_tick(struct proc *p, int slice)
+{
+  return stridetick(&p->ps, slice, tickets(p));
+}
+
+// once p's runtime is used up, edfthrottle() keeps it
+// off the run queues until its next period starts.
+static int
+edf_tick(struct proc *p, int slice)
+{
+  return edftick(&p->ps);
+}
+
+// The scheduling policies, indexed by SCHED_* from sched.h.
+// When a cpu has processes of several policies waiting,
+// those of the lowest rank run first.
+static struct sched_policy {
+  char *name;
+  int rank;                                   // lower runs first
+  int levels;                                 // queue on rq->mlfq[], not rq->heap
+  uint64 (*key)(struct runq*, struct proc*);  // order in rq->heap
+  int (*tick)(struct proc*, int);             // timer tick
+  int slice;                                  // time slice, in ticks
+} policies[NSCHED] = {
+[SCHED_EDF]    { "EDF",    0, 0, edf_key,    edf_tick,    0 },
+[SCHED_RR]     { "RR",     1, 0, rr_key,     slice_tick,  1 },
+[SCHED_FCFS]   { "FCFS",   2, 0, fcfs_key,   slice_tick,  0 },
+[SCHED_PBS]    { "PBS",    3, 0, pbs_key,    slice_tick,  0 },
+[SCHED_MLFQ]   { "MLFQ",   4, 1, 0,          mlfq_tick,   1 },
+[SCHED_CFS]    { "CFS",    5, 0, cfs_key,    cfs_tick,    1 },
+[SCHED_STRIDE] { "STRIDE", 6, 0, stride_key, stride_tick, 1 },
+};
+
+#define RANK(p) ((uint64)policies[(p)->policy].rank)
+
+// Charge a timer tick to p, running on this cpu.
+// Returns 1 if p's policy says it should yield, or
+// its group has used up its cpu quota.
+int
+schedtick(struct proc *p)
+{
+  struct sched_policy *sp;
+  int out;
+
+  // the interrupted code can't hold p->lock: it
+  // would have had interrupts off.
+  acquire(&p->lock);
+  sp = &policies[p->policy];
+  // the policy's own accounting runs either way.
+  out = sp->tick(p, sp->slice) | quotatick(p);
+  release(&p->lock);
+  return out;
+}
+
+// Set policy's time slice, in ticks. A slice < 0
+// changes nothing. Returns the previous slice, or
+// -1 if there is no such policy.
+int
+setslice(int policy, int slice)
+{
+  int old;
+
+  if(policy < 0 || policy >= NSCHED)
+    return -1;
+  old = policies[policy].slice;
+  if(slice >= 0)
+    policies[policy].slice = slice;
+  return old;
+}
+
+// How urgently p wants to run: less is more urgent.
+// A process made runnable preempts a running one that
+// is less urgent. Within RR, CFS and STRIDE all processes
+// tie, so those only switch at ticks; FCFS and PBS compare
+// the key without its FIFO counter, and EDF the deadline.
+static uint64
+urgency(struct proc *p)
+{
+  uint64 rank = RANK(p) << 56;
+
+  if(policies[p->policy].levels)
+    return rank | ((uint64)p->ps.level << 24);
+  if(p->policy == SCHED_RR || p->policy == SCHED_CFS || p->policy == SCHED_STRIDE)
+    return rank;
+  return p->rqkey & ~0xffffffL;
+}
+
+// p has just been queued on c; see that a cpu gets to it
+// soon. If c is idle, wake it. If c is running something
+// less urgent, ask it to reschedule: at its next trap if
+// c is this cpu, or right away with an IPI if not. If c
+// is busy with something better, wake an idle cpu that
+// may run p, to steal it.
+// Caller must have interrupts disabled.
+static void
+preempt(struct cpu *c, struct proc *p)
+{
+  struct proc *cur = c->proc;
+  struct cpu *o;
+
+  // pairs with idle(): either we see that c is
+  // idle, or c sees p in its queue.
+  __sync_synchronize();
+
+  if(c->idle){
+    if(c != mycpu())
+      ipi(c - cpus);
+    return;
+  }
+  if(cur == 0 || cur == p)
+    return;
+  if(urgency(p) < urgency(cur)){
+    c->resched = 1;
+    if(c != mycpu())
+      ipi(c - cpus);
+    return;
+  }
+  for(o = cpus; o < &cpus[NCPU]; o++){
+    if(o != c && o->idle && CANRUN(p, o - cpus)){
+      ipi(o - cpus);
+      return;
+    }
+  }
+}
+
+// Nothing to run here or to steal: wait with wfi for an
+// interrupt, rather than spin taking the queue locks.
+// A cpu that queues work for c sends it an IPI, and so
+// does one that queues work c could steal while it is
+// busy. Work queued just before c went idle waits at
+// most a tick.
+static void
+idle(struct cpu *c)
+{
+  uint64 start;
+
+  intr_off();
+  c->idle = 1;
+  __sync_synchronize();
+  if(c->rq.n == 0){
+    start = r_time();
+    wfi();
+    c->idletime += r_time() - start;
+  }
+  c->idle = 0;
+  // scheduler()'s intr_on() takes the interrupt.
+}
+
+// Has a process that should preempt this cpu's current
+// one been made runnable? Clears the request.
+int
+needresched(void)
+{
+  int r;
+
+  push_off();
+  r = __sync_lock_test_and_set(&mycpu()->resched, 0);
+  pop_off();
+  return r;
+}
+
+// p's key in rq->heap: its policy's rank in the top bits,
+// so that policies are kept apart, then the policy's own key.
+static uint64
+runqkey(struct runq *rq, struct proc *p)
+{
+  return (RANK(p) << 56) | policies[p->policy].key(rq, p);
+}
+
+static void
+runqswap(struct runq *rq, int i, int j)
+{
+  struct proc *t = rq->heap[i];
+
+  rq->heap[i] = rq->heap[j];
+  rq->heap[j] = t;
+  rq->heap[i]->rqidx = i;
+  rq->heap[j]->rqidx = j;
+}
+
+// Restore heap order after the key at index i changed.
+static void
+runqfix(struct runq *rq, int i)
+{
+  int l, r, m;
+
+  while(i > 0 && rq->heap[i]->rqkey < rq->heap[(i-1)/2]->rqkey){
+    runqswap(rq, i, (i-1)/2);
+    i = (i-1)/2;
+  }
+  for(;;){
+    l = 2*i + 1;
+    r = l + 1;
+    m = i;
+    if(l < rq->nheap && rq->heap[l]->rqkey < rq->heap[m]->rqkey)
+      m = l;
+    if(r < rq->nheap && rq->heap[r]->rqkey < rq->heap[m]->rqkey)
+      m = r;
+    if(m == i)
+      break;
+    runqswap(rq, i, m);
+    i = m;
+  }
+}
+
+// Make room in every cpu's rq->heap for n processes.
+// The heaps grow, by doubling, as struct procs are
+// made, before any more can be queued; so runqadd()
+// never runs out of room, and the heaps take memory
+// for the processes there are rather than for NPROC.
+// Returns -1 if memory is short.
+// Caller must hold procs_lock.
+static int
+runqgrow(int n)
+{
+  struct proc **heap[NCPU], **old;
+  struct runq *rq;
+  int order, i;
+
+  if(n <= cpus[0].rq.heapcap)
+    return 0;
+  order = cpus[0].rq.heap ? runqorder + 1 : 0;
+  while((PGSIZE << order) / sizeof(struct proc*) < n)
+    order++;
+
+  for(i = 0; i < NCPU; i++){
+    if((heap[i] = (struct proc**)kallocpages(order)) == 0){
+      while(--i >= 0)
+        kfreepages(heap[i], order);
+      return -1;
+    }
+  }
+  for(i = 0; i < NCPU; i++){
+    rq = &cpus[i].rq;
+    acquire(&rq->lock);
+    old = rq->heap;
+    if(old)
+      memmove(heap[i], old, rq->nheap * sizeof(struct proc*));
+    rq->heap = heap[i];
+    rq->heapcap = (PGSIZE << order) / sizeof(struct proc*);
+    release(&rq->lock);
+    if(old)
+      kfreepages(old, runqorder);
+  }
+  runqorder = order;
+  return 0;
+}
+
+// Put p on rq, where its policy wants it.
+// Caller must hold p->lock and rq->lock, or just
+// rq->lock when moving p between levels of rq.
+static void
+runqadd(struct runq *rq, struct proc *p)
+{
+  if(!policies[p->policy].levels && rq->nheap >= rq->heapcap)
+    panic("runqadd");
+  p->rq = rq;
+  rq->n++;
+
+  if(policies[p->policy].levels){
+    // append to the tail of p's level.
+    struct queue *q = &rq->mlfq[p->ps.level];
+    p->qtime = ticks;
+    p->qnext = 0;
+    p->qprev = q->tail;
+    if(q->tail)
+      q->tail->qnext = p;
+    else
+      q->head = p;
+    q->tail = p;
+    rq->mlfqmask |= 1 << p->ps.level;
+  } else {
+    p->rqkey = runqkey(rq, p);
+    p->rqidx = rq->nheap++;
+    rq->heap[p->rqidx] = p;
+    runqfix(rq, p->rqidx);
+  }
+}
+
+// Take p off rq.
+// Caller must hold rq->lock.
+static void
+runqdel(struct runq *rq, struct proc *p)
+{
+  rq->n--;
+
+  if(policies[p->policy].levels){
+    struct queue *q = &rq->mlfq[p->ps.level];
+    if(p->qprev)
+      p->qprev->qnext = p->qnext;
+    else
+      q->head = p->qnext;
+    if(p->qnext)
+      p->qnext->qprev = p->qprev;
+    else
+      q->tail = p->qprev;
+    if(q->head == 0)
+      rq->mlfqmask &= ~(1 << p->ps.level);
+  } else {
+    int i = p->rqidx;
+    rq->nheap--;
+    if(i != rq->nheap){
+      rq->heap[i] = rq->heap[rq->nheap];
+      rq->heap[i]->rqidx = i;
+      runqfix(rq, i);
+    }
+  }
+
+  p->rq = 0;
+}
+
+// The process rq would run next, or 0.
+// Caller must hold rq->lock.
+static struct proc*
+runqfirst(struct runq *rq)
+{
+  struct proc *p = 0;
+
+  if(rq->nheap > 0)
+    p = rq->heap[0];
+  if(p && (p->rqkey >> 56) < policies[SCHED_MLFQ].rank)
+    return p;
+
+  for(int i = 0; i < NMLFQ; i++)
+    if(rq->mlfqmask & (1 << i))
+      return rq->mlfq[i].head;
+  return p;
+}
+
+// A process rq would run late, cheap to take off
+// rq, for cpu id to steal; or 0. Processes that
+// can't run on cpu id are passed over.
+// Caller must hold rq->lock.
+static struct proc*
+runqlast(struct runq *rq, int id)
+{
+  struct proc *p = 0, *q;
+  int i;
+
+  // the last heap leaf, so removing it moves nothing,
+  // unless pinned processes are in the way.
+  for(i = rq->nheap - 1; i >= 0; i--){
+    if(CANRUN(rq->heap[i], id)){
+      p = rq->heap[i];
+      break;
+    }
+  }
+  if(p && (p->rqkey >> 56) > policies[SCHED_MLFQ].rank)
+    return p;
+
+  for(i = NMLFQ-1; i >= 0; i--){
+    if((rq->mlfqmask & (1 << i)) == 0)
+      continue;
+    for(q = rq->mlfq[i].tail; q; q = q->qprev)
+      if(CANRUN(q, id))
+        return q;
+  }
+  return p;
+}
+
+// Take the first process off c's run queue.
+// Returns 0 if the queue is empty. The caller
+// owns the process until it acquires p->lock
+// and runs it; nobody else can find it.
+static struct proc*
+runqpop(struct cpu *c)
+{
+  struct proc *p;
+
+  // peek without the lock, so that idle cpus
+  // don't bounce each other's queue locks.
+  if(c->rq.n == 0)
+    return 0;
+
+  acquire(&c->rq.lock);
+  if((p = runqfirst(&c->rq)) != 0){
+    runqdel(&c->rq, p);
+    if(p->policy == SCHED_CFS)
+      cfsran(&c->rq.pq, &p->ps);
+    if(p->policy == SCHED_STRIDE)
+      strideran(&c->rq.pq, &p->ps);
+  }
+  release(&c->rq.lock);
+  return p;
+}
+
+// Switch p to policy; its sort key may also have
+// changed. If p is queued, move it to its new place.
+// Caller must hold p->lock.
+static void
+requeue(struct proc *p, int policy)
+{
+  struct runq *rq = p->rq;
+
+  // p can be popped while we wait for rq->lock,
+  // but not queued elsewhere since we hold p->lock.
+  if(rq){
+    acquire(&rq->lock);
+    if(p->rq == rq){
+      runqdel(rq, p);
+      p->policy = policy;
+      runqadd(rq, p);
+      release(&rq->lock);
+      preempt(rq->cpu, p);
+      return;
+    }
+    release(&rq->lock);
+  }
+  p->policy = policy;
+}
+
+// The started cpu with the least work that p may run
+// on, for a process that has no cache to go back to.
+// Caller must have interrupts disabled.
+static struct cpu*
+leastloaded(struct proc *p)
+{
+  struct cpu *c, *best = 0;
+  int load, bestload = 0;
+
+  if(CANRUN(p, cpuid())){
+    best = mycpu();
+    bestload = best->rq.n + (best->proc != 0);
+  }
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    if(!c->started || !CANRUN(p, c - cpus))
+      continue;
+    load = c->rq.n + (c->proc != 0);
+    if(best == 0 || load < bestload){
+      best = c;
+      bestload = load;
+    }
+  }
+  // only at boot, before the other cpus start.
+  if(best == 0)
+    best = mycpu();
+  return best;
+}
+
+// p, an EDF task, is about to be queued. If it has used
+// up its runtime for this period, throttle it: keep it
+// off the run queues until its next job is released, at
+// the start of its next period, when edfrelease() gives
+// it a fresh runtime. As in SCHED_DEADLINE, an overrunning
+// task can then neither take the time reserved for other
+// EDF tasks nor starve the other policies' processes.
+// Returns 1 if p is throttled.
+// Caller must hold p->lock.
+static int
+edfthrottle(struct proc *p)
+{
+  uint next;
+
+  if(p->ps.dlleft > 0)
+    return 0;
+  next = edfnext(&p->ps);
+  if((int)(ticks - next) >= 0){
+    // so late that the next period has begun.
+    edfrefill(&p->ps, next);
+    return 0;
+  }
+  acquire(&edf_lock);
+  p->dlrelease = next;
+  p->dlnext = edfthrottled;
+  edfthrottled = p;
+  release(&edf_lock);
+  return 1;
+}
+
+// Called from clockintr() every tick: queue the throttled
+// EDF tasks whose next period starts now, with a fresh
+// runtime and deadline.
+void
+edfrelease(void)
+{
+  struct proc *p, **pp, *list = 0, *next;
+
+  // most ticks, no EDF task is throttled.
+  if(edfthrottled == 0)
+    return;
+  acquire(&edf_lock);
+  for(pp = &edfthrottled; (p = *pp) != 0; ){
+    if((int)(ticks - p->dlrelease) >= 0){
+      *pp = p->dlnext;
+      p->dlnext = list;
+      list = p;
+    } else
+      pp = &p->dlnext;
+  }
+  release(&edf_lock);
+
+  // nobody else can find these, as in quotaperiod().
+  for(p = list; p; p = next){
+    next = p->dlnext;
+    acquire(&p->lock);
+    edfrefill(&p->ps, p->dlrelease);
+    setrunnable(p);
+    release(&p->lock);
+  }
+}
+
+// Mark p RUNNABLE and queue it on the cpu it last
+// ran on, whose cache is likely still warm, or on the
+// least loaded cpu if it hasn't run yet or may no
+// longer run there.
+// Caller must hold p->lock.
+static void
+setrunnable(struct proc *p)
+{
+  struct cpu *c;
+
+  // charge the sleep that is ending, and
+  // start timing the wait to run.
+  if(p->state == SLEEPING){
+    uint64 now = r_time();
+    p->stime += now - p->stamp;
+    p->stamp = now;
+    trace(p, TRACE_WAKE);
+  } else if(p->state == USED)
+    trace(p, TRACE_NEW);
+
+  p->state = RUNNABLE;
+  if(p->policy == SCHED_EDF && edfthrottle(p))
+    return;
+  if(p->cpu >= 0 && CANRUN(p, p->cpu))
+    c = &cpus[p->cpu];
+  else
+    c = leastloaded(p);
+
+  acquire(&c->rq.lock);
+  runqadd(&c->rq, p);
+  release(&c->rq.lock);
+
+  preempt(c, p);
+}
+
+// Take a process that c would run late off its
+// queue, for cpu to run. This leaves c the work
+// it was about to run next.
+static struct proc*
+runqtail(struct cpu *c, struct cpu *cpu)
+{
+  struct proc *p;
+
+  if(c->rq.n == 0)
+    return 0;
+
+  acquire(&c->rq.lock);
+  if((p = runqlast(&c->rq, cpu - cpus)) != 0)
+    runqdel(&c->rq, p);
+  release(&c->rq.lock);
+  return p;
+}
+
+// This cpu's queue is empty: steal work from the
+// cpu with the most queued, rather than sit idle.
+// The stolen process then belongs to this cpu.
+static struct proc*
+runqsteal(struct cpu *c)
+{
+  struct cpu *o, *victim = 0;
+  struct proc *p;
+
+  for(o = cpus; o < &cpus[NCPU]; o++){
+    if(o == c || !o->started || o->rq.n == 0)
+      continue;
+    if(victim == 0 || o->rq.n > victim->rq.n)
+      victim = o;
+  }
+  if(victim == 0)
+    return 0;
+
+  // all of victim's work may be pinned to it.
+  if((p = runqtail(victim, c)) == 0){
+    for(o = cpus; o < &cpus[NCPU]; o++){
+      if(o == c || o == victim || !o->started)
+        continue;
+      if((p = runqtail(o, c)) != 0)
+        break;
+    }
+    if(p == 0)
+      return 0;
+  }
+  c->rq.nsteal++;
+  return p;
+}
+
+// Called from clockintr() every BALANCEINT ticks:
+// hand one queued process from the busiest cpu to
+// the least busy one, so that work spreads out
+// before anyone has to steal it.
+void
+runqbalance(void)
+{
+  struct cpu *c, *src = 0, *dst = 0;
+  int load, srcload = 0, dstload = 0;
+  struct proc *p;
+
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    if(!c->started)
+      continue;
+    load = c->rq.n + (c->proc != 0);
+    if(src == 0 || load > srcload){
+      src = c;
+      srcload = load;
+    }
+    if(dst == 0 || load < dstload){
+      dst = c;
+      dstload = load;
+    }
+  }
+  if(src == 0 || srcload - dstload < 2)
+    return;
+
+  if((p = runqtail(src, dst)) == 0)
+    return;
+  acquire(&p->lock);
+  p->cpu = dst - cpus;
+  setrunnable(p);
+  release(&p->lock);
+  dst->rq.nbalance++;
+}
+
+// Called from clockintr(): move MLFQ processes that have
+// waited MLFQAGE ticks at their level up a level, so that
+// the CPU-bound ones at the bottom don't starve. Levels
+// are FIFO, so only the heads need looking at.
+void
+mlfqage(void)
+{
+  struct cpu *c;
+  struct proc *p;
+
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    if(!c->started || c->rq.mlfqmask == 0)
+      continue;
+    acquire(&c->rq.lock);
+    for(int i = 1; i < NMLFQ; i++){
+      while((p = c->rq.mlfq[i].head) != 0 && ticks - p->qtime >= MLFQAGE){
+        runqdel(&c->rq, p);
+        p->ps.level = i - 1;
+        p->ps.slice = 0;
+        runqadd(&c->rq, p);
+      }
+    }
+    release(&c->rq.lock);
+  }
+}
+
+// p is about to run on c: charge it for the time it
+// waited to run, and record that in c's histogram.
+// Caller must hold p->lock.
+static void
+switchin(struct cpu *c, struct proc *p)
+{
+  uint64 now = r_time();
+  uint64 us = (now - p->stamp) / (MTIMEHZ / 1000000);
+  int i;
+
+  for(i = 0; us > 0 && i < NLATHIST - 1; i++)
+    us >>= 1;
+  c->lathist[i]++;
+  c->nswitch++;
+  p->wtime += now - p->stamp;
+
+  if(p->lastcpu >= 0 && p->lastcpu != c - cpus){
+    p->nmigrate++;
+    c->nmigrate++;
+  }
+  p->lastcpu = c - cpus;
+
+  // a kernel stack has been mapped where another
+  // was, maybe p's own; drop stale translations.
+  if(c->kstackgen != kstackgen){
+    c->kstackgen = kstackgen;
+    sfence_vma();
+  }
+
+  p->num_of_runs += 1;
+  p->state = RUNNING;
+  p->cpu = c - cpus;
+  p->stamp = now;
+  c->proc = p;
+  trace(p, TRACE_RUN);
+}
+
+// p has stopped running: charge it for the time it ran.
+// Caller must hold p->lock.
+static void
+switchout(struct proc *p)
+{
+  uint64 now = r_time();
+
+  p->rtime += now - p->stamp;
+  quotacharge(p, now - p->stamp);
+  p->stamp = now;
+}
+
+// p, holding p->lock, is about to block. If the process
+// it last woke is still waiting to run, and is what this
+// cpu would run next anyway or this cpu has nothing else
+// to do, take it off its queue, lock it and return it,
+// for p to switch to directly. Otherwise return 0.
+// p->lock is held while acquiring the wakee's lock:
+// nothing else holds two p->locks, and a queued process
+// can't be handing off itself, so this can't deadlock.
+static struct proc*
+takewakee(struct proc *p)
+{
+  struct proc *q = p->wakee;
+  struct cpu *c = mycpu();
+  struct runq *rq;
+
+  p->wakee = 0;
+  if(q == 0 || (rq = q->rq) == 0 || !CANRUN(q, cpuid()))
+    return 0;
+  if(rq != &c->rq && c->rq.n > 0)
+    return 0;
+
+  acquire(&rq->lock);
+  if(q->rq != rq || (rq == &c->rq && runqfirst(rq) != q)){
+    release(&rq->lock);
+    return 0;
+  }
+  runqdel(rq, q);
+  release(&rq->lock);
+
+  // q is ours now, as if runqpop() had returned it.
+  acquire(&q->lock);
+  if(q->state != RUNNABLE || quotapark(q)){
+    release(&q->lock);
+    return 0;
+  }
+  return q;
+}
+
+// Switch from p, which is blocking, straight to q, without
+// going through scheduler(): one context switch instead of
+// two, for a process that wakes another and waits for its
+// answer, like either end of a pipe. Both locks are held;
+// q releases p->lock once it is running, in finishswitch().
+static void
+handoff(struct proc *p, struct proc *q)
+{
+  struct cpu *c = mycpu();
+
+  switchout(p);
+  switchin(c, q);
+  c->prev = p;
+  c->rq.nhandoff++;
+  swtch(&p->context, &q->context);
+}
+
+// Called by a process as soon as it runs again: if it was
+// switched to by handoff(), release the lock of the
+// process that handed off, whose context is now saved.
+static void
+finishswitch(void)
+{
+  struct cpu *c = mycpu();
+  struct proc *prev = c->prev;
+
+  if(prev){
+    c->prev = 0;
+    release(&prev->lock);
+  }
+}
+
+// Per-CPU process scheduler.
+// Each CPU calls scheduler() after setting itself up.
+// Scheduler never returns.  It loops, doing:
+//  - take the first process off this cpu's run queue,
+//    ordered by the policy selected with SCHEDULER.
+//  - or steal one from another cpu, or wait in wfi
+//    until there is one.
+//  - swtch to start running that process.
+//  - eventually that process transfers control
+//    via swtch back to the scheduler.
+void
+scheduler(void)
+{
+  struct proc *p;
+  struct cpu *c = mycpu();
+
+  c->proc = 0;
+  c->started = 1;
+
+  for(;;){
+    // Avoid deadlock by ensuring that devices can interrupt.
+    intr_on();
+
+    // whatever asked for a reschedule is queued,
+    // and is about to be considered.
+    c->resched = 0;
+
+    if((p = runqpop(c)) == 0 && (p = runqsteal(c)) == 0){
+      idle(c);
+      continue;
+    }
+
+    acquire(&p->lock);
+    if(p->state == RUNNABLE && !CANRUN(p, cpuid())){
+      // its affinity changed after it was queued here.
+      setrunnable(p);
+    } else if(p->state == RUNNABLE && quotapark(p)){
+      // its group is out of quota; quotaperiod()
+      // will queue it again.
+    } else if(p->state == RUNNABLE){
+      // Switch to chosen process.  It is the process's job
+      // to release its lock and then reacquire it
+      // before jumping back to us.
+      switchin(c, p);
+      swtch(&c->context, &p->context);
+
+      // Process is done running for now.
+      // It should have changed its p->state before coming back.
+      // It may not be p, if p handed the cpu straight to
+      // another process (see handoff()); c->proc is the
+      // one that came back, holding its lock.
+      p = c->proc;
+      c->proc = 0;
+      switchout(p);
+    }
+    release(&p->lock);
+  }
+}
+
+
+// Switch to scheduler, or straight to the process p just
+// woke if p is blocking (see takewakee()). Must hold only
+// p->lock and have changed proc->state. Saves and restores
+// intena because intena is a property of this
+// kernel thread, not this CPU. It should
+// be proc->intena and proc->noff, but that would
+// break in the few places where a lock is held but
+// there's no process.
+void
+sched(void)
+{
+  int intena;
+  struct proc *p = myproc();
+  struct proc *q;
+
+  if(!holding(&p->lock))
+    panic("sched p->lock");
+  if(mycpu()->noff != 1)
+    panic("sched locks");
+  if(p->state == RUNNING)
+    panic("sched running");
+  if(intr_get())
+    panic("sched interruptible");
+
+  if(p->state == SLEEPING){
+    p->nvcsw++;
+    mycpu()->nvcsw++;
+    trace(p, TRACE_BLOCK);
+  } else if(p->state == RUNNABLE){
+    p->nivcsw++;
+    mycpu()->nivcsw++;
+    trace(p, TRACE_PREEMPT);
+  } else if(p->state == ZOMBIE)
+    trace(p, TRACE_EXIT);
+
+  intena = mycpu()->intena;
+  if(p->state == SLEEPING && (q = takewakee(p)) != 0)
+    handoff(p, q);
+  else
+    swtch(&p->context, &mycpu()->context);
+  finishswitch();
+  mycpu()->intena = intena;
+}
+
+// Give up the CPU for one scheduling round.
+void
+yield(void)
+{
+  struct proc *p = myproc();
+  acquire(&p->lock);
+  setrunnable(p);
+  sched();
+  release(&p->lock);
+}
+
+// A fork child's very first scheduling by scheduler()
+// will swtch to forkret.
+void
+forkret(void)
+{
+  static int first = 1;
+
+  // Still holding p->lock from scheduler, or
+  // from handoff() with the lock of the process
+  // that handed off.
+  finishswitch();
+  release(&myproc()->lock);
+
+  if (first) {
+    // File system initialization must be run in the context of a
+    // regular process (e.g., because it calls sleep), and thus cannot
+    // be run from main().
+    first = 0;
+    fsinit(ROOTDEV);
   }
 
   usertrapret();
 }
 
+// Take p off the sleepers in p->wq.
+// Caller must hold p->wq->lock.
+static void
+waitqdel(struct proc *p)
+{
+  struct waitq *wq = p->wq;
+
+  if(p->wprev)
+    p->wprev->wnext = p->wnext;
+  else
+    wq->head = p->wnext;
+  if(p->wnext)
+    p->wnext->wprev = p->wprev;
+  else
+    wq->tail = p->wprev;
+  p->wq = 0;
+}
+
 // Atomically release lock and sleep on chan.
 // Reacquires lock when awakened.
 void
 sleep(void *chan, struct spinlock *lk)
 {
   struct proc *p = myproc();
+  struct waitq *wq = &waitq[WAITQHASH(chan)];
   
-  // Must acquire p->lock in order to
-  // change p->state and then call sched.
-  // Once we hold p->lock, we can be
+  // Must acquire wq->lock in order to join
+  // the sleepers on chan, and p->lock in order
+  // to change p->state and then call sched.
+  // Once we hold wq->lock, we can be
   // guaranteed that we won't miss any wakeup
-  // (wakeup locks p->lock),
+  // (wakeup locks wq->lock),
   // so it's okay to release lk.
 
-  acquire(&p->lock);  //DOC: sleeplock1
+  acquire(&wq->lock);  //DOC: sleeplock1
+  acquire(&p->lock);
   release(lk);
 
   // Go to sleep.
   p->chan = chan;
   p->state = SLEEPING;
+  p->wq = wq;
+  p->wprev = wq->tail;
+  p->wnext = 0;
+  if(wq->tail)
+    wq->tail->wnext = p;
+  else
+    wq->head = p;
+  wq->tail = p;
+  release(&wq->lock);
 
   sched();
 
   // Tidy up.
   p->chan = 0;
+  release(&p->lock);
+
+  // wakeup() took p off wq, unless kill() woke it.
+  acquire(&wq->lock);
+  if(p->wq)
+    waitqdel(p);
+  release(&wq->lock);
 
   // Reacquire original lock.
-  release(&p->lock);
   acquire(lk);
 }
 
+// Wake up processes sleeping on chan: all of
+// them, or only the one that has slept longest.
+// If hint is set and exactly one woke, the caller
+// may hand its cpu to that one when it next blocks.
+// Must be called without any p->lock.
+static void
+wakeupn(void *chan, int all, int hint)
+{
+  struct waitq *wq = &waitq[WAITQHASH(chan)];
+  struct proc *p, *next, *woke = 0;
+  int n = 0;
+
+  acquire(&wq->lock);
+  for(p = wq->head; p; p = next){
+    next = p->wnext;
+    if(p->chan != chan)
+      continue;
+    acquire(&p->lock);
+    if(p->state == SLEEPING && p->chan == chan) {
+      waitqdel(p);
+      setrunnable(p);
+      woke = p;
+      n++;
+      if(!all){
+        release(&p->lock);
+        break;
+      }
+    }
+    release(&p->lock);
+  }
+  release(&wq->lock);
+
+  // if the caller blocks next, it may hand its cpu
+  // straight to the one process it woke.
+  if(hint && n == 1)
+    myproc()->wakee = woke;
+}
+
 // Wake up all processes sleeping on chan.
 // Must be called without any p->lock.
 void
 wakeup(void *chan)
 {
-  struct proc *p;
+  wakeupn(chan, 1, 0);
+}
 
-  for(p = proc; p < &proc[NPROC]; p++) {
-    if(p != myproc()){
-      acquire(&p->lock);
-      if(p->state == SLEEPING && p->chan == chan) {
-        p->state = RUNNABLE;
-      }
-      release(&p->lock);
-    }
-  }
+// Wake up all processes sleeping on chan, as a process
+// that will likely block soon waiting for the one it
+// woke to answer, like either end of a pipe; see
+// takewakee(). Only for process context: an interrupt
+// handler would leave the hint on whatever process it
+// interrupted, which woke nobody.
+// Must be called without any p->lock.
+void
+wakeuphandoff(void *chan)
+{
+  wakeupn(chan, 1, 1);
+}
+
+// Wake up the process that has slept longest on chan,
+// for channels where any one sleeper can use what
+// became free, and waking the rest would only send
+// them back to sleep.
+// Must be called without any p->lock.
+void
+wakeupone(void *chan)
+{
+  wakeupn(chan, 0, 0);
 }
 
 // Kill the process with the given pid.
@@ -928,20 +2485,15 @@ kill(int pid)
 {
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++){
-    acquire(&p->lock);
-    if(p->pid == pid){
-      p->killed = 1;
-      if(p->state == SLEEPING){
-        // Wake process from sleep().
-        p->state = RUNNABLE;
-      }
-      release(&p->lock);
-      return 0;
-    }
-    release(&p->lock);
+  if((p = getproc(pid)) == 0)
+    return -1;
+  p->killed = 1;
+  if(p->state == SLEEPING){
+    // Wake process from sleep().
+    setrunnable(p);
   }
-  return -1;
+  release(&p->lock);
+  return 0;
 }
 
 // Copy to either a user address, or kernel address,
@@ -974,6 +2526,38 @@ either_copyin(void *dst, int user_src, uint64 src, uint64 len)
   }
 }
 
+// Copy cpu's scheduling counters to user address addr,
+// as a struct schedstat. Returns -1 if there is no such
+// cpu. The counters are read without locks, so they may
+// be a switch or two apart.
+int
+schedstat(int cpu, uint64 addr)
+{
+  struct schedstat st;
+  struct cpu *c;
+
+  if(cpu < 0 || cpu >= NCPU || !cpus[cpu].started)
+    return -1;
+  c = &cpus[cpu];
+
+  st.time = r_time();
+  st.idle = c->idletime;
+  st.nswitch = c->nswitch;
+  st.nvcsw = c->nvcsw;
+  st.nivcsw = c->nivcsw;
+  st.nmigrate = c->nmigrate;
+  st.nsteal = c->rq.nsteal;
+  st.nbalance = c->rq.nbalance;
+  st.nhandoff = c->rq.nhandoff;
+  st.nqueued = c->rq.n;
+  for(int i = 0; i < NLATHIST; i++)
+    st.lat[i] = c->lathist[i];
+
+  if(copyout(myproc()->pagetable, addr, (char *)&st, sizeof(st)) < 0)
+    return -1;
+  return 0;
+}
+
 // Print a process listing to console.  For debugging.
 // Runs when user types ^P on console.
 // No lock to avoid wedging a stuck machine further.
@@ -989,12 +2573,27 @@ procdump(void)
   };
   struct proc *p;
   char *state;
+  uint rtime;
 
   printf("\n");
-  #ifdef PBS
-  printf("PID\tPriority\tState\trtime\twtime\tnrun\n");
-  #endif
-  for(p = proc; p < &proc[NPROC]; p++)
+  switch(schedpolicy){
+  case SCHED_PBS:
+    printf("PID\tPriority\tState\trtime\twtime\tnrun");
+    break;
+  case SCHED_MLFQ:
+    printf("PID\tPriority\tState\trtime\twtime\tnrun\tq0\tq1\tq2\tq3\tq4");
+    break;
+  case SCHED_CFS:
+    printf("PID\tPriority\tState\trtime\twtime\tnrun\tvruntime");
+    break;
+  case SCHED_STRIDE:
+    printf("PID\tTickets\t\tState\trtime\twtime\tnrun\tpass");
+    break;
+  default:
+    printf("PID State Name");
+  }
+  printf("\tqwait\tvcsw\tivcsw\tmigr\n");
+  for(p = procs; p; p = p->allnext)
   {
     if(p->state == UNUSED)
       continue;
@@ -1002,16 +2601,41 @@ procdump(void)
       state = states[p->state];
     else
       state = "???";
-    //printf("%d\t%s\t%s\t\t%d\t%d\t%d\t%d\t%d\t%d\t%d", p->pid, state, p->name, p->ctime, p->rtime, p->stime, p->priority, p->niceness, p->dynamic_priority, p->num_of_runs);     
-    
-    #ifdef PBS
-      printf("%d\t%d\t\t%s\t%d\t%d\t%d", p->pid, p->dynamic_priority, state, p->rtime, (ticks - p->rtime), p->num_of_runs);      
-    #else
-    #ifndef PBS
-     printf("%d %s %s", p->pid, state, p->name);
-    #endif
-    #endif
+    rtime = runticks(p);
+
+    switch(schedpolicy){
+    case SCHED_PBS:
+      printf("%d\t%d\t\t%s\t%d\t%d\t%d", p->pid, p->dynamic_priority, state, rtime, ticks - rtime, p->num_of_runs);
+      break;
+    case SCHED_MLFQ:
+      printf("%d\t%d\t\t%s\t%d\t%d\t%d", p->pid, p->ps.level, state, rtime, ticks - rtime, p->num_of_runs);
+      for(int i = 0; i < NMLFQ; i++)
+        printf("\t%d", p->qticks[i]);
+      break;
+    case SCHED_CFS:
+      printf("%d\t%d\t\t%s\t%d\t%d\t%d\t%d", p->pid, p->ps.priority, state, rtime, ticks - rtime, p->num_of_runs, (int)p->ps.vruntime);
+      break;
+    case SCHED_STRIDE:
+      printf("%d\t%d\t\t%s\t%d\t%d\t%d\t%d", p->pid, tickets(p), state, rtime, ticks - rtime, p->num_of_runs, (int)(p->ps.pass / STRIDE1));
+      break;
+    default:
+      printf("%d %s %s", p->pid, state, p->name);
+    }
+    printf("\t%d\t%d\t%d\t%d", (int)(p->wtime / TICKCYCLES),
+           p->nvcsw, p->nivcsw, p->nmigrate);
+    if(p->policy != schedpolicy)
+      printf("\t(%s)", policies[p->policy].name);
 
     printf("\n");
   }
+
+  struct cpu *c;
+  for(c = cpus; c < &cpus[NCPU]; c++){
+    if(c->started)
+      printf("cpu %d: %d queued, %d switches (%d blocked, %d preempted), "
+             "%d migrations, %d stolen, %d balanced, %d handoffs, %d ticks idle\n",
+             (int)(c - cpus), c->rq.n, c->nswitch, c->nvcsw, c->nivcsw,
+             c->nmigrate, c->rq.nsteal, c->rq.nbalance,
+             c->rq.nhandoff, (int)(c->idletime / TICKCYCLES));
+  }
 }
@@ -18,12 +18,55 @@ struct context {
   uint64 s11;
 };
 
+// One level of the multi-level feedback queue:
+// a FIFO list threaded through p->qnext/p->qprev.
+struct queue {
+  struct proc *head;
+  struct proc *tail;
+};
+
+// Per-CPU run queue of RUNNABLE processes.
+// A binary min-heap ordered by p->rqkey, so
+// picking the next process is O(log n) and
+// never looks at processes that can't run.
+// heap[] has room for every struct proc there
+// is, and grows with them; see runqgrow().
+// MLFQ processes go on the mlfq[] levels instead,
+// with a bit set in mlfqmask for each non-empty one.
+struct runq {
+  struct spinlock lock;
+  struct cpu *cpu;            // The cpu this queue feeds
+  int n;                      // Number of queued processes
+  int nheap;                  // Number of them in heap[]
+  struct policyq pq;          // Policies' state, see policy.h
+  uint nsteal;                // Processes this cpu stole when idle
+  uint nbalance;              // Processes runqbalance() moved here
+  uint nhandoff;              // Switches straight from a blocking process to its wakee
+  struct proc **heap;
+  int heapcap;                // Room in heap[]
+  struct queue mlfq[NMLFQ];
+  uint mlfqmask;
+};
+
 // Per-CPU state.
 struct cpu {
   struct proc *proc;          // The process running on this cpu, or null.
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  int started;                // Has this cpu entered scheduler()?
+  int resched;                // Should proc yield to a better one?
+  int idle;                   // Waiting in wfi for work?
+  uint64 idletime;            // r_time() cycles spent idle
+  uint nswitch;               // Switches to a process
+  uint nvcsw;                 // Switches away from a process that blocked
+  uint nivcsw;                // Switches away from a process that was preempted
+  uint nmigrate;              // Switches to a process that last ran elsewhere
+  uint lathist[NLATHIST];     // Run queue waits, see struct schedstat
+  int edfutil;                // Per mille reserved by EDF tasks here, under edf_lock
+  struct proc *prev;          // Process that handed off to proc; its lock is still held
+  uint kstackgen;             // kstackgen when this cpu last flushed its TLB
+  struct runq rq;             // Processes waiting to run on this cpu.
 };
 
 extern struct cpu cpus[NCPU];
@@ -80,26 +123,6 @@ struct trapframe {
   /* 280 */ uint64 t6;
 };
 
-
-//#ifdef MLFQ
-
-// struct queue 
-// {
-//   int start;                 // start index
-//   int end;                   // end index
-//   struct proc *que[NPROC];     // array of `struct proc` pointers
-// };
-
-// struct queue mlfq[5];
-
-// void pushback(queue *, struct proc *);          // pushing process to the end of the queue
-// void deletefront(queue *);                      // deleting process 
-// void deleteIndx(queue *, int);                   // deleting process with given index in the queue (for ageing)
-// int size(queue *);                              // size of the Queue
-// void ageproc(void);                             // ageing the processes 
-
-//#endif
-
 enum procstate { UNUSED, USED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
 // Per-process state
@@ -112,12 +135,56 @@ struct proc {
   int killed;                  // If non-zero, have been killed
   int xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
+  int cpu;                     // CPU this process last ran on, or -1
+  uint affinity;               // Bit i set if p may run on cpu i
+  uint64 rtime;                // Run time, in r_time() cycles (Q2)
+  uint64 stime;                // Sleeping time, in r_time() cycles
+  uint64 wtime;                // Time spent RUNNABLE, in r_time() cycles
+  uint64 stamp;                // r_time() when p last started or stopped running,
+                               // or became RUNNABLE
+  int lastcpu;                 // CPU p last ran on, or -1
+  uint nvcsw;                  // Times p blocked in sched()
+  uint nivcsw;                 // Times p was preempted in sched()
+  uint nmigrate;               // Times p ran on a different cpu than last time
+
+  // rq->lock of the queue p is on must be held when using these:
+  struct runq *rq;             // Run queue p is on, or 0
+  int rqidx;                   // Index of p in rq->heap
+  uint64 rqkey;                // Sort key in rq->heap
+  struct proc *qnext;          // Next in rq->mlfq[level]
+  struct proc *qprev;          // Previous in rq->mlfq[level]
+  uint qtime;                  // When p joined rq->mlfq[level]
+
+  // wq->lock of the wait queue p is on must be held when using these:
+  struct waitq *wq;            // Sleepers on p->chan's bucket p is in, or 0
+  struct proc *wnext;          // Next sleeper in wq
+  struct proc *wprev;          // Previous sleeper in wq
 
-  // wait_lock must be held when using this:
+  // wait_lock must be held when using these:
   struct proc *parent;         // Parent process
+  struct proc *children;       // Children still running
+  struct proc *zombies;        // Children that have exited, for wait()
+  struct proc *snext;          // Next on parent->children or parent->zombies
+  struct proc *sprev;          // Previous on it
+
+  // set once, before p is on procs, so procs can be walked without a lock:
+  struct proc *allnext;        // Next in procs, the list of every struct proc
+
+  // procs_lock must be held when using this:
+  struct proc *freenext;       // Next in procfree, if UNUSED
+
+  // pid_lock must be held when using this:
+  struct proc *pidnext;        // Next in p->pid's pidhash[] chain
+
+  // tickslock must be held when using these:
+  int intimer;                 // Is p in the timer wheel?
+  uint wakeat;                 // Tick p's sleep() ends at
+  struct proc *tnext;          // Next in timers[wakeat % NTIMER]
+  struct proc *tprev;          // Previous in timers[wakeat % NTIMER]
 
   // these are private to the process, so p->lock need not be held.
-  uint64 kstack;               // Virtual address of kernel stack
+  uint64 kstack;               // Virtual address of kernel stack, KSTACK(slot)
+  uint64 kstackpa;             // Its physical memory, or 0 if unmapped; under procs_lock
   uint64 sz;                   // Size of process memory (bytes)
   pagetable_t pagetable;       // User page table
   struct trapframe *trapframe; // data page for trampoline.S
@@ -125,16 +192,27 @@ struct proc {
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
-  int tracemask;               // Trace Mask to store the mask passed by the user **
+  uint64 tracemask;            // Trace Mask to store the mask passed by the user **
   int ctime;                   // Create time of the process (Q2)
-  int rtime;                   // Run time of the process (Q2)
   int etime;                   // End time of the process (Q2)
-  int priority;                // Process priority for PBS
-  int stime;                   // Sleeping time of the process 
+  struct policystate ps;       // Policies' state: priority, MLFQ level, vruntime, ...
   int dynamic_priority;
   int niceness;
-  //int queue;                   // queue the process is in
-  //int sched_time;              // scheduled time (MLFQ)
+  int policy;                  // Scheduling policy, SCHED_* in sched.h
+  int borrowed;                // tickets lent by blocked clients (STRIDE)
+  struct proc *lentto;         // server p lent its tickets to, or 0
+  int lentpid;                 // pid of lentto, in case it exited
+  int lent;                    // tickets lent
+  uint dlrelease;              // tick the next period starts, if throttled (EDF)
+  struct proc *dlnext;         // Next throttled EDF task, under edf_lock
+  int dlcpu;                   // cpu the reservation is on (EDF)
+  int dlutil;                  // per mille of dlcpu reserved (EDF)
+  uint dlmask;                 // affinity before becoming EDF
+  int pgid;                    // Process group, for cpu quotas
+  struct pgroup *pgroup;       // Its quota group, or 0; valid if qgen is current
+  uint qgen;                   // quotagen when pgroup was looked up
+  struct proc *gnext;          // Next parked in its group, under pgroup_lock
+  struct proc *wakee;          // Last process p alone woke up, a handoff hint
   int num_of_runs;             // number of times a process ran (MLFQ)
-  //int ticks[5];         // Number of ticks the process receives at the `i`th queue
+  int qticks[NMLFQ];           // Number of ticks the process receives at the `i`th queue
 };
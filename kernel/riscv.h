@@ -323,6 +323,14 @@ r_ra()
   return x;
 }
 
+// wait for an interrupt; returns at once if one is
+// pending, even with interrupts disabled.
+static inline void
+wfi()
+{
+  asm volatile("wfi");
+}
+
 // flush the TLB.
 static inline void
 sfence_vma()
@@ -343,6 +351,7 @@ sfence_vma()
 #define PTE_W (1L << 2)
 #define PTE_X (1L << 3)
 #define PTE_U (1L << 4) // 1 -> user can access
+#define PTE_COW (1L << 8) // RSW bit: shared copy-on-write, copy on store
 
 // shift a physical address to the right place for a PTE.
 #define PA2PTE(pa) ((((uint64)pa) >> 12) << 10)
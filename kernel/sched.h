@@ -0,0 +1,58 @@
+// Scheduling policies, for sched_setpolicy().
+#define SCHED_RR    0  // round robin
+#define SCHED_FCFS  1  // first come first served
+#define SCHED_PBS   2  // priority based
+#define SCHED_MLFQ  3  // multi-level feedback queue
+#define SCHED_CFS   4  // completely fair, by virtual runtime
+#define SCHED_STRIDE 5 // proportional share, by stride pass
+#define SCHED_EDF   6  // real time, earliest deadline first; see sched_setdeadline()
+#define NSCHED      7
+
+// One cpu's scheduling counters, for schedstat().
+// Times are in CLINT_MTIME cycles (MTIMEHZ a second).
+// lat[i] counts the switches to a process that had waited
+// to run less than 2^i microseconds, and at least half that.
+struct schedstat {
+  uint64 time;                // cycles since boot
+  uint64 idle;                // cycles spent idle
+  uint nswitch;               // switches to a process
+  uint nvcsw;                 // switches away from a process that blocked
+  uint nivcsw;                // switches away from a process that was preempted
+  uint nmigrate;              // switches to a process that last ran on another cpu
+  uint nsteal;                // processes stolen from other cpus
+  uint nbalance;              // processes moved here by rebalancing
+  uint nhandoff;              // switches straight from a blocking process to its wakee
+  uint nqueued;               // processes waiting to run here now
+  uint lat[NLATHIST];
+};
+
+// A process's counters, from waitx().
+// Times are in ticks.
+struct procstat {
+  uint rtime;                 // time running
+  uint wtime;                 // time waiting to run
+  uint stime;                 // time sleeping
+  uint nrun;                  // times it was switched to
+  uint nvcsw;                 // times it blocked
+  uint nivcsw;                // times it was preempted
+  uint nmigrate;              // times it moved to another cpu
+};
+
+// Scheduler trace events, for schedtrace() and readtrace().
+#define TRACE_NEW     1  // a new process became RUNNABLE
+#define TRACE_RUN     2  // switched to, RUNNING
+#define TRACE_PREEMPT 3  // switched away from, still RUNNABLE
+#define TRACE_BLOCK   4  // switched away from, SLEEPING
+#define TRACE_WAKE    5  // woken up, RUNNABLE again
+#define TRACE_EXIT    6  // switched away from for good, ZOMBIE
+
+// One trace event. time is in CLINT_MTIME cycles
+// since tracing was turned on.
+struct tracerec {
+  uint64 time;
+  int pid;
+  uchar cpu;                  // cpu the event happened on
+  uchar event;                // TRACE_*
+  uchar policy;               // SCHED_* of the process
+  uchar priority;             // its static priority
+};
@@ -0,0 +1,196 @@
+// Slab allocator, for small kernel objects: pipes,
+// open files and in-memory inodes.
+//
+// A cache hands out objects of one size. It carves
+// them from slabs, pages from kalloc() that start with
+// a struct slab and hold as many objects as fit after
+// it; a free object's first word links it to the next
+// free one in its slab. Slabs with free objects are on
+// the cache's partial list. A slab that no longer has
+// any objects in use goes back to kalloc(), unless the
+// cache would be left without a slab's worth of free
+// objects.
+//
+// In front of the slabs, each cpu has a magazine of
+// up to MAGSIZE free objects that only it uses, with
+// interrupts off, so that most allocations and frees
+// take no lock at all. An empty magazine is filled,
+// and a full one emptied, by half under the cache lock.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "riscv.h"
+#include "defs.h"
+
+#define NCACHE   8    // most caches
+#define MAGSIZE 16    // most objects in a cpu's magazine
+
+struct slab {
+  struct slab *next;          // on the cache's partial list
+  struct slab *prev;
+  struct kmem_cache *cache;
+  void *free;                 // free objects, linked by their first word
+  int inuse;                  // objects allocated from this slab
+};
+
+#define SLABHDR ((sizeof(struct slab) + 7) & ~7)
+
+struct magazine {
+  int n;
+  void *obj[MAGSIZE];
+};
+
+struct kmem_cache {
+  struct spinlock lock;       // protects the slabs, not the magazines
+  char *name;
+  uint size;                  // object size, a multiple of 8
+  int perslab;                // objects per slab
+  struct slab *partial;       // slabs with free objects
+  int nfree;                  // free objects in slabs
+  struct magazine mag[NCPU];
+};
+
+static struct kmem_cache caches[NCACHE];
+static int ncache;
+
+// Make a cache of objects of size bytes, at most
+// a page less a slab header. Called only during boot,
+// on one cpu.
+struct kmem_cache*
+kmem_cache_create(char *name, uint size)
+{
+  struct kmem_cache *c;
+
+  size = (size + 7) & ~7;
+  if(ncache == NCACHE || size == 0 || size > PGSIZE - SLABHDR)
+    panic("kmem_cache_create");
+  c = &caches[ncache++];
+  initlock(&c->lock, name);
+  c->name = name;
+  c->size = size;
+  c->perslab = (PGSIZE - SLABHDR) / size;
+  return c;
+}
+
+static void
+pushslab(struct kmem_cache *c, struct slab *s)
+{
+  s->prev = 0;
+  s->next = c->partial;
+  if(s->next)
+    s->next->prev = s;
+  c->partial = s;
+}
+
+static void
+unlinkslab(struct kmem_cache *c, struct slab *s)
+{
+  if(s->prev)
+    s->prev->next = s->next;
+  else
+    c->partial = s->next;
+  if(s->next)
+    s->next->prev = s->prev;
+}
+
+// Take an object from c's slabs, making a new slab
+// if none has one free. Returns 0 if memory is short.
+// Caller must hold c->lock.
+static void*
+slaballoc(struct kmem_cache *c)
+{
+  struct slab *s = c->partial;
+  void *obj;
+
+  if(s == 0){
+    if((s = (struct slab*)kalloc()) == 0)
+      return 0;
+    s->cache = c;
+    s->inuse = 0;
+    s->free = 0;
+    for(int i = c->perslab - 1; i >= 0; i--){
+      obj = (char*)s + SLABHDR + i * c->size;
+      *(void**)obj = s->free;
+      s->free = obj;
+    }
+    pushslab(c, s);
+    c->nfree += c->perslab;
+  }
+
+  obj = s->free;
+  s->free = *(void**)obj;
+  s->inuse++;
+  c->nfree--;
+  if(s->free == 0)
+    unlinkslab(c, s);
+  return obj;
+}
+
+// Put obj back in its slab, and the slab back to
+// kalloc() if it is unused and c has enough free
+// objects without it. Caller must hold c->lock.
+static void
+slabfree(struct kmem_cache *c, void *obj)
+{
+  struct slab *s = (struct slab*)PGROUNDDOWN((uint64)obj);
+
+  if(s->cache != c || s->inuse < 1)
+    panic("kmem_cache_free");
+  if(s->free == 0)
+    pushslab(c, s);
+  *(void**)obj = s->free;
+  s->free = obj;
+  s->inuse--;
+  c->nfree++;
+
+  if(s->inuse == 0 && c->nfree > c->perslab){
+    unlinkslab(c, s);
+    c->nfree -= c->perslab;
+    kfree(s);
+  }
+}
+
+// Allocate an object from cache c. Its contents are
+// junk. Returns 0 if the memory cannot be allocated.
+void*
+kmem_cache_alloc(struct kmem_cache *c)
+{
+  struct magazine *m;
+  void *obj;
+
+  push_off();
+  m = &c->mag[cpuid()];
+  if(m->n == 0){
+    acquire(&c->lock);
+    while(m->n < MAGSIZE / 2 && (obj = slaballoc(c)) != 0)
+      m->obj[m->n++] = obj;
+    release(&c->lock);
+  }
+  obj = m->n > 0 ? m->obj[--m->n] : 0;
+  pop_off();
+  return obj;
+}
+
+// Free obj, which must have come from
+// kmem_cache_alloc(c).
+void
+kmem_cache_free(struct kmem_cache *c, void *obj)
+{
+  struct magazine *m;
+
+  // Fill with junk to catch dangling refs.
+  memset(obj, 1, c->size);
+
+  push_off();
+  m = &c->mag[cpuid()];
+  if(m->n == MAGSIZE){
+    acquire(&c->lock);
+    while(m->n > MAGSIZE / 2)
+      slabfree(c, m->obj[--m->n]);
+    release(&c->lock);
+  }
+  m->obj[m->n++] = obj;
+  pop_off();
+}
@@ -3,6 +3,7 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "spinlock.h"
+#include "policy.h"
 #include "proc.h"
 #include "syscall.h"
 #include "defs.h"
@@ -107,6 +108,20 @@ extern uint64 sys_write(void);
 extern uint64 sys_uptime(void);
 extern uint64 sys_strace(void);      // **
 extern uint64 sys_setpriority(void);      // (Q2 - PBS)
+extern uint64 sys_sched_setpolicy(void);
+extern uint64 sys_sched_setslice(void);
+extern uint64 sys_nanosleep(void);
+extern uint64 sys_sched_setaffinity(void);
+extern uint64 sys_sched_getaffinity(void);
+extern uint64 sys_getcpu(void);
+extern uint64 sys_sched_setdeadline(void);
+extern uint64 sys_setpgid(void);
+extern uint64 sys_getpgid(void);
+extern uint64 sys_setquota(void);
+extern uint64 sys_quotastat(void);
+extern uint64 sys_schedstat(void);
+extern uint64 sys_schedtrace(void);
+extern uint64 sys_readtrace(void);
 
 static uint64 (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -133,6 +148,20 @@ static uint64 (*syscalls[])(void) = {
 [SYS_strace]  sys_strace,      //**
 [SYS_waitx]   sys_waitx,       // (Q2)
 [SYS_setpriority]   sys_setpriority,       // (Q2 - PBS)
+[SYS_sched_setpolicy]   sys_sched_setpolicy,
+[SYS_sched_setslice]    sys_sched_setslice,
+[SYS_nanosleep]         sys_nanosleep,
+[SYS_sched_setaffinity] sys_sched_setaffinity,
+[SYS_sched_getaffinity] sys_sched_getaffinity,
+[SYS_getcpu]            sys_getcpu,
+[SYS_sched_setdeadline] sys_sched_setdeadline,
+[SYS_setpgid]           sys_setpgid,
+[SYS_getpgid]           sys_getpgid,
+[SYS_setquota]          sys_setquota,
+[SYS_quotastat]         sys_quotastat,
+[SYS_schedstat]         sys_schedstat,
+[SYS_schedtrace]        sys_schedtrace,
+[SYS_readtrace]         sys_readtrace,
 };
 
 
@@ -143,6 +172,10 @@ static char *syscall_names[] = {
   "exec", "open", "mknod", "unlink", "fstat", 
   "link", "mkdir", "chdir", "dup", "getpid", 
   "sbrk", "sleep", "uptime", "strace", "waitx", "setpriority",
+  "sched_setpolicy", "sched_setslice", "nanosleep",
+  "sched_setaffinity", "sched_getaffinity", "getcpu",
+  "sched_setdeadline", "setpgid", "getpgid", "setquota", "quotastat",
+  "schedstat", "schedtrace", "readtrace",
 };
 
 
@@ -152,7 +185,11 @@ static int syscall_arg_count[] = {
   3, 3, 1, 1, 
   2, 2, 3, 1, 2, 
   2, 1, 1, 1, 0, 
-  1, 1, 0, 1, 3, 2,
+  1, 1, 0, 1, 4, 2,
+  2, 2, 2,
+  2, 1, 0,
+  3, 2, 1, 2, 3,
+  2, 1, 2,
 };
 
 void
@@ -168,7 +205,7 @@ syscall(void)
     p->trapframe->a0 = syscalls[num]();
 
     //** modifying syscall to print the strace **//
-    if ((p->tracemask >> num) & 1) 
+    if ((p->tracemask >> num) & 1L) 
     {
       printf("%d: syscall %s (%d", p->pid, syscall_names[num], arg);
 
@@ -23,3 +23,17 @@
 #define SYS_strace 22       //**
 #define SYS_waitx  23       // (Q2)
 #define SYS_setpriority  24       // (Q2 - PBS)
+#define SYS_sched_setpolicy  25
+#define SYS_sched_setslice   26
+#define SYS_nanosleep        27
+#define SYS_sched_setaffinity 28
+#define SYS_sched_getaffinity 29
+#define SYS_getcpu           30
+#define SYS_sched_setdeadline 31
+#define SYS_setpgid          32
+#define SYS_getpgid          33
+#define SYS_setquota         34
+#define SYS_quotastat        35
+#define SYS_schedstat        36
+#define SYS_schedtrace       37
+#define SYS_readtrace        38
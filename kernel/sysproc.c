@@ -5,6 +5,7 @@
 #include "param.h"
 #include "memlayout.h"
 #include "spinlock.h"
+#include "policy.h"
 #include "proc.h"
 
 uint64
@@ -56,21 +57,25 @@ uint64
 sys_sleep(void)
 {
   int n;
-  uint ticks0;
 
   if(argint(0, &n) < 0)
     return -1;
-  acquire(&tickslock);
-  ticks0 = ticks;
-  while(ticks - ticks0 < n){
-    if(myproc()->killed){
-      release(&tickslock);
-      return -1;
-    }
-    sleep(&ticks, &tickslock);
-  }
-  release(&tickslock);
-  return 0;
+  return ticksleep(n);
+}
+
+uint64
+sys_nanosleep(void)
+{
+  int sec;
+  int nsec;
+  if(argint(0, &sec) < 0)
+    return -1;
+  if(argint(1, &nsec) < 0)
+    return -1;
+  if(sec < 0 || nsec < 0 || nsec >= 1000000000)
+    return -1;
+
+  return nanosleep((uint64)sec * 1000000000 + nsec);
 }
 
 uint64
@@ -100,9 +105,10 @@ sys_uptime(void)
 uint64
 sys_strace(void)
 {
-  int n;
+  uint64 n;
 
-  if(argint(0, &n) < 0)       //setting mask arg given by user to n
+  // 64 bits, one per syscall; there are more than 32.
+  if(argaddr(0, &n) < 0)       //setting mask arg given by user to n
   {
     return -1;
   }
@@ -116,7 +122,7 @@ sys_strace(void)
 uint64
 sys_waitx(void)
 {
-  uint64 addr, addr1, addr2;
+  uint64 addr, addr1, addr2, addr3;
   uint wtime, rtime;
   if(argaddr(0, &addr) < 0)
     return -1;
@@ -124,7 +130,9 @@ sys_waitx(void)
     return -1;
   if(argaddr(2, &addr2) < 0)
     return -1;
-  int ret = waitx(addr, &wtime, &rtime);
+  if(argaddr(3, &addr3) < 0) // struct procstat, or 0
+    return -1;
+  int ret = waitx(addr, &wtime, &rtime, addr3);
   struct proc* p = myproc();
   if (copyout(p->pagetable, addr1,(char*)&wtime, sizeof(int)) < 0)
     return -1;
@@ -146,3 +154,176 @@ sys_setpriority(void)
 
   return setpriority(priority, pid);
 }
+
+// switch a process, or with pid 0 the whole system,
+// to a scheduling policy; returns the previous one.
+uint64
+sys_sched_setpolicy(void)
+{
+  int policy;
+  int pid;
+  if(argint(0, &policy) < 0)
+    return -1;
+  if(argint(1, &pid) < 0)
+    return -1;
+
+  return setpolicy(policy, pid);
+}
+
+uint64
+sys_sched_setslice(void)
+{
+  int policy;
+  int slice;
+  if(argint(0, &policy) < 0)
+    return -1;
+  if(argint(1, &slice) < 0)
+    return -1;
+
+  return setslice(policy, slice);
+}
+
+uint64
+sys_sched_setaffinity(void)
+{
+  int pid;
+  int mask;
+  if(argint(0, &pid) < 0)
+    return -1;
+  if(argint(1, &mask) < 0)
+    return -1;
+
+  return setaffinity(pid, mask);
+}
+
+uint64
+sys_sched_getaffinity(void)
+{
+  int pid;
+  if(argint(0, &pid) < 0)
+    return -1;
+
+  return getaffinity(pid);
+}
+
+uint64
+sys_sched_setdeadline(void)
+{
+  int runtime, period, deadline;
+  if(argint(0, &runtime) < 0)
+    return -1;
+  if(argint(1, &period) < 0)
+    return -1;
+  if(argint(2, &deadline) < 0)
+    return -1;
+
+  return setdeadline(runtime, period, deadline);
+}
+
+uint64
+sys_setpgid(void)
+{
+  int pid, pgid;
+  if(argint(0, &pid) < 0)
+    return -1;
+  if(argint(1, &pgid) < 0)
+    return -1;
+
+  return setpgid(pid, pgid);
+}
+
+uint64
+sys_getpgid(void)
+{
+  int pid;
+  if(argint(0, &pid) < 0)
+    return -1;
+
+  return getpgid(pid);
+}
+
+uint64
+sys_setquota(void)
+{
+  int pgid, quota;
+  if(argint(0, &pgid) < 0)
+    return -1;
+  if(argint(1, &quota) < 0)
+    return -1;
+
+  return setquota(pgid, quota);
+}
+
+// like waitx(): a group's quota, and the ticks
+// its processes used and the periods it ran out.
+uint64
+sys_quotastat(void)
+{
+  int pgid;
+  uint64 addr1, addr2;
+  uint rtime, nthrottle;
+  if(argint(0, &pgid) < 0)
+    return -1;
+  if(argaddr(1, &addr1) < 0)
+    return -1;
+  if(argaddr(2, &addr2) < 0)
+    return -1;
+  int ret = quotastat(pgid, &rtime, &nthrottle);
+  if(ret < 0)
+    return -1;
+  struct proc* p = myproc();
+  if (copyout(p->pagetable, addr1, (char*)&rtime, sizeof(int)) < 0)
+    return -1;
+  if (copyout(p->pagetable, addr2, (char*)&nthrottle, sizeof(int)) < 0)
+    return -1;
+  return ret;
+}
+
+// a cpu's scheduling counters, as a struct schedstat.
+uint64
+sys_schedstat(void)
+{
+  int cpu;
+  uint64 addr;
+  if(argint(0, &cpu) < 0)
+    return -1;
+  if(argaddr(1, &addr) < 0)
+    return -1;
+  return schedstat(cpu, addr);
+}
+
+// turn the scheduler trace on or off.
+uint64
+sys_schedtrace(void)
+{
+  int on;
+  if(argint(0, &on) < 0)
+    return -1;
+  return schedtrace(on != 0);
+}
+
+// take up to n traced events, as struct tracerecs.
+uint64
+sys_readtrace(void)
+{
+  uint64 addr;
+  int n;
+  if(argaddr(0, &addr) < 0)
+    return -1;
+  if(argint(1, &n) < 0)
+    return -1;
+  return readtrace(addr, n);
+}
+
+// the cpu the caller is running on; it may have
+// moved by the time it looks.
+uint64
+sys_getcpu(void)
+{
+  int id;
+
+  push_off();
+  id = cpuid();
+  pop_off();
+  return id;
+}
@@ -0,0 +1,126 @@
+// Scheduler trace: a ring of recent scheduling events
+// per cpu, for replaying workloads in the scheduler
+// simulator, sim/schedsim.c. Off until schedtrace(1).
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "policy.h"
+#include "proc.h"
+#include "sched.h"
+#include "defs.h"
+
+// Only its own cpu adds to a ring; the lock is for
+// readtrace(), which drains them all.
+struct tracebuf {
+  struct spinlock lock;
+  uint head;                  // Index of the oldest event
+  uint n;                     // Number of events in rec[]
+  uint lost;                  // Events overwritten before they were read
+  struct tracerec rec[NTRACE];
+};
+
+static struct tracebuf tracebufs[NCPU];
+static volatile int tracing;
+static uint64 tracestart;      // r_time() when tracing was turned on
+
+void
+traceinit(void)
+{
+  for(int i = 0; i < NCPU; i++)
+    initlock(&tracebufs[i].lock, "trace");
+}
+
+// Record event for p, on this cpu. Once a ring is
+// full, new events overwrite the oldest.
+// Caller must hold p->lock.
+void
+trace(struct proc *p, int event)
+{
+  struct tracebuf *b;
+  struct tracerec *r;
+
+  if(!tracing)
+    return;
+
+  push_off();
+  b = &tracebufs[cpuid()];
+  acquire(&b->lock);
+  if(b->n == NTRACE){
+    b->head = (b->head + 1) % NTRACE;
+    b->n--;
+    b->lost++;
+  }
+  r = &b->rec[(b->head + b->n) % NTRACE];
+  r->time = r_time() - tracestart;
+  r->pid = p->pid;
+  r->cpu = cpuid();
+  r->event = event;
+  r->policy = p->policy;
+  r->priority = p->ps.priority;
+  b->n++;
+  release(&b->lock);
+  pop_off();
+}
+
+// Turn tracing on (on = 1), emptying the rings, or off
+// (on = 0). Returns the number of events lost since it
+// was last turned on.
+int
+schedtrace(int on)
+{
+  int lost = 0;
+
+  if(on)
+    tracing = 0;
+  for(int i = 0; i < NCPU; i++){
+    struct tracebuf *b = &tracebufs[i];
+    acquire(&b->lock);
+    lost += b->lost;
+    if(on){
+      b->head = 0;
+      b->n = 0;
+      b->lost = 0;
+    }
+    release(&b->lock);
+  }
+  if(on)
+    tracestart = r_time();
+  tracing = on;
+  return lost;
+}
+
+// Copy up to n of the oldest traced events to user
+// address addr, taking them off the rings. Each cpu's
+// events are in time order, but not the cpus' with
+// each other. Returns the number copied, or -1.
+int
+readtrace(uint64 addr, int n)
+{
+  struct proc *p = myproc();
+  struct tracerec r;
+  int copied = 0;
+
+  for(int i = 0; i < NCPU && copied < n; i++){
+    struct tracebuf *b = &tracebufs[i];
+    for(;;){
+      acquire(&b->lock);
+      if(b->n == 0){
+        release(&b->lock);
+        break;
+      }
+      r = b->rec[b->head];
+      b->head = (b->head + 1) % NTRACE;
+      b->n--;
+      release(&b->lock);
+
+      if(copyout(p->pagetable, addr + copied * sizeof(r), (char *)&r, sizeof(r)) < 0)
+        return -1;
+      if(++copied == n)
+        break;
+    }
+  }
+  return copied;
+}
@@ -3,14 +3,24 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "spinlock.h"
+#include "policy.h"
 #include "proc.h"
 #include "defs.h"
 
 struct spinlock tickslock;
 uint ticks;
 
+// Processes in sleep(), in slot wakeat % NTIMER of a
+// timer wheel, so that each tick clockintr() only
+// looks at the processes that might be due.
+// tickslock must be held when using it.
+static struct proc *timers[NTIMER];
+
 extern char trampoline[], uservec[], userret[];
 
+// in start.c; timervec sets timer_scratch[hart][6] on each tick.
+extern uint64 timer_scratch[NCPU][7];
+
 // in kernelvec.S, calls kerneltrap().
 void kernelvec();
 
@@ -67,6 +77,11 @@ usertrap(void)
     syscall();
   } else if((which_dev = devintr()) != 0){
     // ok
+  } else if((r_scause() == 13 || r_scause() == 15) &&
+            lazyfault(p->pagetable, r_stval(), p->sz) == 0){
+    // first touch of a page sbrk() added, now zeroed
+  } else if(r_scause() == 15 && cowfault(p->pagetable, r_stval()) == 0){
+    // store to a copy-on-write page, now copied
   } else {
     printf("usertrap(): unexpected scause %p pid=%d\n", r_scause(), p->pid);
     printf("            sepc=%p stval=%p\n", r_sepc(), r_stval());
@@ -76,13 +91,11 @@ usertrap(void)
   if(p->killed)
     exit(-1);
 
-  // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2)
-  {
-    #ifdef RR
+  // give up the CPU if this is a timer interrupt
+  // and the process's scheduling policy says so, or
+  // if a more urgent process has become runnable.
+  if((which_dev == 2 && schedtick(p)) || needresched())
     yield();
-    #endif
-  }
 
   usertrapret();
 }
@@ -106,7 +119,7 @@ usertrapret(void)
   // set up trapframe values that uservec will need when
   // the process next re-enters the kernel.
   p->trapframe->kernel_satp = r_satp();         // kernel page table
-  p->trapframe->kernel_sp = p->kstack + PGSIZE; // process's kernel stack
+  p->trapframe->kernel_sp = p->kstack + KSTACKSIZE; // process's kernel stack
   p->trapframe->kernel_trap = (uint64)usertrap;
   p->trapframe->kernel_hartid = r_tp();         // hartid for cpuid()
 
@@ -153,37 +166,12 @@ kerneltrap()
     panic("kerneltrap");
   }
 
-  // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2 && myproc() != 0 && myproc()->state == RUNNING)
+  // give up the CPU if this is a timer interrupt and the
+  // policy says so, or a more urgent process is runnable.
+  if(myproc() != 0 && myproc()->state == RUNNING)
   {
-
-    //#if !defined(FCFS) || !defined(PBS)
-    #ifdef RR
+    if((which_dev == 2 && schedtick(myproc())) || needresched())
       yield();
-    #endif
-
-
-  // #ifdef MLFQ
-  //   // Check the waiting times and push the respective processes down the queue
-  //   struct proc * p = myproc();
-  //   if(which_dev == 2 && myproc() != 0 && myproc()->state == RUNNING) 
-  //   {
-  //       p->ticks[p->queue]++;
-
-  //       if(ticks - p->sched_time >= (1 << p->queue)) 
-  //       {
-  //         yield();
-  //         int newQ = p->queue + 1;
-  //         if (p->queue >= NPROC)
-  //             newQ = NPROC - 1;
-  //         struct proc * del = mlfq[p->queue].que[mlfq[p->queue].start];
-  //         deletefront(&mlfq[p->queue]);
-  //         del->queue = newQ;
-  //         del->sched_time = ticks;
-  //         pushback(&mlfq[newQ], del);
-  //       }
-  //   }
-  // #endif
   }
 
   // the yield() may have caused some traps to occur,
@@ -192,40 +180,133 @@ kerneltrap()
   w_sstatus(sstatus);
 }
 
+// Add p to the timer wheel, to wake at tick p->wakeat.
+// Caller must hold tickslock.
+static void
+timeradd(struct proc *p)
+{
+  struct proc **slot = &timers[p->wakeat % NTIMER];
+
+  p->tprev = 0;
+  p->tnext = *slot;
+  if(*slot)
+    (*slot)->tprev = p;
+  *slot = p;
+  p->intimer = 1;
+}
+
+// Take p out of the timer wheel.
+// Caller must hold tickslock.
+static void
+timerdel(struct proc *p)
+{
+  if(p->tprev)
+    p->tprev->tnext = p->tnext;
+  else
+    timers[p->wakeat % NTIMER] = p->tnext;
+  if(p->tnext)
+    p->tnext->tprev = p->tprev;
+  p->intimer = 0;
+}
+
+// Sleep for n ticks. Only clockintr() wakes the
+// process, when the n ticks are up.
+// Returns -1 if the process is killed first.
+int
+ticksleep(int n)
+{
+  struct proc *p = myproc();
+
+  if(n <= 0)
+    return 0;
+  acquire(&tickslock);
+  p->wakeat = ticks + n;
+  timeradd(p);
+  while(p->intimer){
+    if(p->killed){
+      timerdel(p);
+      release(&tickslock);
+      return -1;
+    }
+    sleep(&p->wakeat, &tickslock);
+  }
+  release(&tickslock);
+  return 0;
+}
+
+// Sleep for ns nanoseconds: whole ticks in ticksleep(),
+// then give up the cpu until CLINT_MTIME reaches the
+// end, for a resolution of 1/MTIMEHZ second rather than
+// a tick, at the cost of staying runnable for the rest.
+// Returns -1 if the process is killed first.
+int
+nanosleep(uint64 ns)
+{
+  volatile uint64 *mtime = (uint64*)CLINT_MTIME;
+  uint64 end = *mtime + ns / (1000000000 / MTIMEHZ);
+  uint64 now;
+
+  while((now = *mtime) < end){
+    if(myproc()->killed)
+      return -1;
+    // n ticks may end a little after n-1 tick intervals,
+    // but never after n, so this doesn't overshoot.
+    if(end - now >= TICKCYCLES){
+      if(ticksleep((end - now) / TICKCYCLES) < 0)
+        return -1;
+    } else {
+      yield();
+    }
+  }
+  return 0;
+}
+
 void
 clockintr()
 {
+  struct proc *p, *next;
+
   acquire(&tickslock);
   ticks++;
 
-  // //  updating run time of the process (Q2) //
-
-  // //get current process
-  // struct proc * current_process = myproc();
-  
-  // //check if process is valid
-  // if(current_process)
-  // {
-  //   //check if process is running
-  //   if(current_process->state == RUNNING)
-  //   {
-  //     current_process->rtime++;
-  //   }
-  // }
-
-  update_time();
-
-  // #ifdef MLFQ
-  //   ageproc();
-  // #endif
-
-  wakeup(&ticks);
+  // wake the processes whose sleep() ends now; the
+  // others in this slot are due NTIMER ticks or more
+  // from now.
+  for(p = timers[ticks % NTIMER]; p; p = next){
+    next = p->tnext;
+    if(p->wakeat == ticks){
+      timerdel(p);
+      wakeup(&p->wakeat);
+    }
+  }
   release(&tickslock);
+
+  // spread queued work over the cpus.
+  if(ticks % BALANCEINT == 0)
+    runqbalance();
+
+  mlfqage();
+
+  // throttled EDF tasks whose next period has begun.
+  edfrelease();
+
+  // fresh cpu quotas for process groups.
+  if(ticks % QUOTAPERIOD == 0)
+    quotaperiod();
+}
+
+// Interrupt another hart, for example to make it
+// reschedule; it will see devintr() return 3.
+void
+ipi(int hart)
+{
+  *(uint32*)CLINT_MSIP(hart) = 1;
 }
 
 // check if it's an external interrupt or software interrupt,
 // and handle it.
 // returns 2 if timer interrupt,
+// 3 if an IPI from another hart,
 // 1 if other device,
 // 0 if not recognized.
 int
@@ -256,16 +337,23 @@ devintr()
 
     return 1;
   } else if(scause == 0x8000000000000001L){
-    // software interrupt from a machine-mode timer interrupt,
-    // forwarded by timervec in kernelvec.S.
+    // software interrupt from a machine-mode timer interrupt
+    // or IPI, forwarded by timervec in kernelvec.S.
+
+    // acknowledge the software interrupt by clearing
+    // the SSIP bit in sip, before looking at the tick
+    // mark so that a tick arriving now isn't lost.
+    w_sip(r_sip() & ~2);
+
+    if(__sync_lock_test_and_set(&timer_scratch[cpuid()][6], 0) == 0){
+      // an IPI from ipi(): the caller's trap handler
+      // checks for work to switch to.
+      return 3;
+    }
 
     if(cpuid() == 0){
       clockintr();
     }
-    
-    // acknowledge the software interrupt by clearing
-    // the SSIP bit in sip.
-    w_sip(r_sip() & ~2);
 
     return 2;
   } else {
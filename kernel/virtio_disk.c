@@ -166,7 +166,6 @@ free_desc(int i)
   disk.desc[i].flags = 0;
   disk.desc[i].next = 0;
   disk.free[i] = 1;
-  wakeup(&disk.free[0]);
 }
 
 // free a chain of descriptors.
@@ -182,6 +181,9 @@ free_chain(int i)
     else
       break;
   }
+  // a chain is the three descriptors that one
+  // waiting virtio_disk_rw() needs.
+  wakeupone(&disk.free[0]);
 }
 
 // allocate three descriptors (they need not be contiguous).
@@ -0,0 +1,468 @@
+// Scheduler simulator: replays a trace recorded on xv6
+// with the schedtrace command against the scheduling
+// policies, at host speed, and prints the same metrics as
+// schedulertest, one line per policy.
+//
+//   schedsim [-c ncpu] [-p policy] [trace]
+//
+// The trace is schedtrace's output, as captured from the
+// console; other lines are ignored. Each process in it
+// becomes a list of cpu bursts and the sleeps between
+// them. The replay is open loop: a process sleeps as long
+// as it did when traced, whatever the policy, so processes
+// that wait on each other, say over a pipe, aren't
+// modelled as such. Time runs in steps of 1/STEPS of a
+// tick. As in the kernel, the policies order waiting
+// processes by a sort key, smallest first, and decide to
+// preempt at timer ticks; the key and tick functions are
+// kernel/policy.h's, which kernel/proc.c uses too.
+//
+// To try a new policy, add its key and tick functions to
+// kernel/policy.h, and an entry in policies[] here that
+// calls them.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/sched.h"
+#include "kernel/policy.h"
+
+#define STEPS 100   // simulation steps per tick
+#define MAXCPU 64
+
+enum { WAITING, READY, RUNNING, SLEEPING, DONE };
+
+struct task {
+  int pid;
+  int nburst;
+  long *run;          // steps of cpu in each burst
+  long *sleep;        // steps asleep after each burst
+  long arrive;        // step it first became runnable
+
+  // replay state
+  int state;
+  int burst;          // burst it is in
+  long left;          // steps left in it
+  long until;         // step a sleep ends
+  long since;         // step it became READY
+  uint64 key;
+  long ctime, etime, rtime, wtime, stime;
+  struct policystate ps;  // ps.priority is as traced
+};
+
+struct event {
+  long time;          // microseconds
+  int cpu, pid, event, policy, priority;
+  int order;          // line in the trace, to sort stably
+};
+
+static struct task *tasks;
+static int ntask;
+static long usperstep = 100000 / STEPS;
+
+// replay state shared by the policies, like a run queue's.
+static struct policyq pq;
+static long now;
+
+// ---------------------------------------------------------
+// Policies, from kernel/policy.h. The READY tasks stand
+// in for a run queue.
+
+static int
+slice_tick(struct task *t, int slice)
+{
+  return slicetick(&t->ps, slice);
+}
+
+static uint64
+rr_key(struct task *t)
+{
+  return rrkey(&pq);
+}
+
+static uint64
+fcfs_key(struct task *t)
+{
+  return fcfskey(&pq, t->ctime);
+}
+
+static uint64
+pbs_key(struct task *t)
+{
+  int nice;
+
+  return pbskey(&pq, pbsprio(t->ps.priority, t->rtime, t->stime, &nice));
+}
+
+// the kernel keeps a FIFO per level; a key does the same.
+static uint64
+mlfq_key(struct task *t)
+{
+  return ((uint64)t->ps.level << 48) | rrkey(&pq);
+}
+
+static int
+mlfq_tick(struct task *t, int slice)
+{
+  uint waiting = 0;
+
+  for(int i = 0; i < ntask; i++)
+    if(tasks[i].state == READY)
+      waiting |= 1 << tasks[i].ps.level;
+  return mlfqtick(&t->ps, slice, waiting);
+}
+
+static uint64
+cfs_key(struct task *t)
+{
+  return cfskey(&pq, &t->ps);
+}
+
+static int
+cfs_tick(struct task *t, int slice)
+{
+  struct policystate *first = 0;
+
+  for(int i = 0; i < ntask; i++)
+    if(tasks[i].state == READY &&
+       (first == 0 || tasks[i].ps.vruntime < first->vruntime))
+      first = &tasks[i].ps;
+  return cfstick(&t->ps, slice, first);
+}
+
+static uint64
+stride_key(struct task *t)
+{
+  return stridekey(&pq, &t->ps);
+}
+
+static int
+stride_tick(struct task *t, int slice)
+{
+  return stridetick(&t->ps, slice, stridetickets(t->ps.priority));
+}
+
+static struct simpolicy {
+  char *name;
+  uint64 (*key)(struct task*);
+  int (*tick)(struct task*, int);
+  int slice;
+} policies[] = {
+  { "RR",     rr_key,     slice_tick,  1 },
+  { "FCFS",   fcfs_key,   slice_tick,  0 },
+  { "PBS",    pbs_key,    slice_tick,  0 },
+  { "MLFQ",   mlfq_key,   mlfq_tick,   1 },
+  { "CFS",    cfs_key,    cfs_tick,    1 },
+  { "STRIDE", stride_key, stride_tick, 1 },
+};
+#define NPOLICY (sizeof(policies) / sizeof(policies[0]))
+
+// ---------------------------------------------------------
+// Reading the trace.
+
+static int
+cmpevent(const void *a, const void *b)
+{
+  const struct event *x = a, *y = b;
+
+  if(x->time != y->time)
+    return x->time < y->time ? -1 : 1;
+  return x->order - y->order;
+}
+
+static long
+steps(long us)
+{
+  return (us + usperstep - 1) / usperstep;
+}
+
+static struct task*
+findtask(int pid)
+{
+  for(int i = 0; i < ntask; i++)
+    if(tasks[i].pid == pid)
+      return &tasks[i];
+  tasks = realloc(tasks, (ntask + 1) * sizeof(*tasks));
+  memset(&tasks[ntask], 0, sizeof(*tasks));
+  tasks[ntask].pid = pid;
+  tasks[ntask].arrive = -1;
+  return &tasks[ntask++];
+}
+
+static void
+addburst(struct task *t, long run)
+{
+  t->run = realloc(t->run, (t->nburst + 1) * sizeof(long));
+  t->sleep = realloc(t->sleep, (t->nburst + 1) * sizeof(long));
+  t->run[t->nburst] = run > 0 ? run : 1;
+  t->sleep[t->nburst] = 0;
+  t->nburst++;
+}
+
+// Turn the events into each process's bursts and sleeps;
+// returns the number of cpus seen.
+static int
+load(FILE *f)
+{
+  struct event *ev = 0;
+  int nev = 0, ncpu = 0, tick;
+  long *runstart, *burst, *sleepstart, end = 0;
+  int *inrun;
+  char line[256];
+
+  while(fgets(line, sizeof(line), f)){
+    if(sscanf(line, "# schedtrace %*s us-per-tick %d", &tick) == 1 && tick > 0)
+      usperstep = tick / STEPS > 0 ? tick / STEPS : 1;
+    if(line[0] != 'T')
+      continue;
+    ev = realloc(ev, (nev + 1) * sizeof(*ev));
+    if(sscanf(line, "T %ld %d %d %d %d %d", &ev[nev].time, &ev[nev].cpu,
+              &ev[nev].pid, &ev[nev].event, &ev[nev].policy, &ev[nev].priority) != 6)
+      continue;
+    ev[nev].order = nev;
+    if(ev[nev].cpu + 1 > ncpu)
+      ncpu = ev[nev].cpu + 1;
+    nev++;
+  }
+  qsort(ev, nev, sizeof(*ev), cmpevent);
+
+  for(int i = 0; i < nev; i++)
+    findtask(ev[i].pid);
+  runstart = calloc(ntask, sizeof(long));
+  burst = calloc(ntask, sizeof(long));
+  sleepstart = calloc(ntask, sizeof(long));
+  inrun = calloc(ntask, sizeof(int));
+
+  for(int i = 0; i < nev; i++){
+    struct task *t = findtask(ev[i].pid);
+    int k = t - tasks;
+    long s = steps(ev[i].time);
+
+    t->ps.priority = ev[i].priority;
+    end = ev[i].time;
+    // a process that first stops was running when the
+    // trace began; one that first wakes, sleeping.
+    if(t->arrive < 0){
+      if(ev[i].event == TRACE_NEW || ev[i].event == TRACE_RUN || ev[i].event == TRACE_WAKE)
+        t->arrive = s;
+      else
+        t->arrive = 0;
+    }
+    inrun[k] = ev[i].event == TRACE_RUN;
+    switch(ev[i].event){
+    case TRACE_RUN:
+      runstart[k] = ev[i].time;
+      break;
+    case TRACE_PREEMPT:
+      burst[k] += ev[i].time - runstart[k];
+      break;
+    case TRACE_BLOCK:
+      burst[k] += ev[i].time - runstart[k];
+      addburst(t, steps(burst[k]));
+      burst[k] = 0;
+      sleepstart[k] = ev[i].time;
+      break;
+    case TRACE_WAKE:
+      if(t->nburst > 0)
+        t->sleep[t->nburst - 1] = steps(ev[i].time - sleepstart[k]);
+      break;
+    case TRACE_EXIT:
+      burst[k] += ev[i].time - runstart[k];
+      addburst(t, steps(burst[k]));
+      burst[k] = -1;
+      break;
+    }
+  }
+  // still running or runnable when the trace ended.
+  for(int k = 0; k < ntask; k++){
+    if(inrun[k])
+      burst[k] += end - runstart[k];
+    if(burst[k] > 0 || tasks[k].nburst == 0)
+      addburst(&tasks[k], steps(burst[k]));
+  }
+
+  free(ev);
+  free(runstart);
+  free(burst);
+  free(sleepstart);
+  free(inrun);
+  return ncpu;
+}
+
+// ---------------------------------------------------------
+// Replay.
+
+static void
+ready(struct simpolicy *sp, struct task *t)
+{
+  t->state = READY;
+  t->since = now;
+  t->key = sp->key(t);
+}
+
+static void
+simulate(struct simpolicy *sp, int ncpu)
+{
+  struct task *running[MAXCPU];
+  int ndone = 0;
+
+  memset(&pq, 0, sizeof(pq));
+  now = 0;
+  for(int i = 0; i < ntask; i++){
+    struct task *t = &tasks[i];
+    t->state = WAITING;
+    t->burst = 0;
+    t->left = t->run[0];
+    t->rtime = t->wtime = t->stime = 0;
+    t->ps.slice = t->ps.level = 0;
+    t->ps.vruntime = t->ps.pass = 0;
+  }
+  memset(running, 0, sizeof(running));
+
+  while(ndone < ntask){
+    for(int i = 0; i < ntask; i++){
+      struct task *t = &tasks[i];
+      if(t->state == WAITING && t->arrive <= now){
+        t->ctime = now;
+        ready(sp, t);
+      } else if(t->state == SLEEPING && t->until <= now){
+        t->stime += t->sleep[t->burst - 1];
+        ready(sp, t);
+      }
+    }
+
+    for(int c = 0; c < ncpu; c++){
+      struct task *best = 0;
+      if(running[c])
+        continue;
+      for(int i = 0; i < ntask; i++)
+        if(tasks[i].state == READY && (best == 0 || tasks[i].key < best->key))
+          best = &tasks[i];
+      if(best == 0)
+        break;
+      best->state = RUNNING;
+      best->wtime += now - best->since;
+      cfsran(&pq, &best->ps);
+      strideran(&pq, &best->ps);
+      running[c] = best;
+    }
+
+    now++;
+    for(int c = 0; c < ncpu; c++){
+      struct task *t = running[c];
+      if(t == 0)
+        continue;
+      t->rtime++;
+      if(--t->left == 0){
+        running[c] = 0;
+        if(++t->burst == t->nburst){
+          t->state = DONE;
+          t->etime = now;
+          ndone++;
+        } else {
+          t->state = SLEEPING;
+          t->until = now + t->sleep[t->burst - 1];
+          t->left = t->run[t->burst];
+        }
+      } else if(now % STEPS == 0 && sp->tick(t, sp->slice)){
+        running[c] = 0;
+        ready(sp, t);
+      }
+    }
+  }
+}
+
+static int
+cmplong(const void *a, const void *b)
+{
+  long x = *(const long *)a, y = *(const long *)b;
+
+  return x < y ? -1 : x > y;
+}
+
+// print the metrics schedulertest does, in ticks.
+static void
+report(struct simpolicy *sp, int ncpu)
+{
+  long *turn = calloc(ntask, sizeof(long));
+  double tturn = 0, twait = 0, trun = 0, sum = 0, sumsq = 0;
+  long end = 0;
+
+  for(int i = 0; i < ntask; i++){
+    struct task *t = &tasks[i];
+    double share;
+    turn[i] = t->etime - t->ctime;
+    tturn += turn[i];
+    twait += t->wtime;
+    trun += t->rtime;
+    share = turn[i] > 0 ? (double)t->rtime / turn[i] : 1;
+    sum += share;
+    sumsq += share * share;
+    if(t->etime > end)
+      end = t->etime;
+  }
+  qsort(turn, ntask, sizeof(long), cmplong);
+
+  printf("workload=trace policy=%s ncpu=%d nproc=%d ticks=%.2f throughput=%.2f "
+         "turnaround_mean=%.2f turnaround_p99=%.2f wtime_mean=%.2f rtime_mean=%.2f jain=%d\n",
+         sp->name, ncpu, ntask, (double)end / STEPS,
+         end > 0 ? ntask * 1000.0 * STEPS / end : 0,
+         tturn / ntask / STEPS, (double)turn[(ntask * 99 + 99) / 100 - 1] / STEPS,
+         twait / ntask / STEPS, trun / ntask / STEPS,
+         sumsq > 0 ? (int)(sum * sum * 1000 / (ntask * sumsq)) : 1000);
+  free(turn);
+}
+
+static void
+usage(void)
+{
+  fprintf(stderr, "Usage: schedsim [-c ncpu] [-p RR|FCFS|PBS|MLFQ|CFS|STRIDE] [trace]\n");
+  exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int ncpu = 0, i, traced, ran = 0;
+  char *policy = 0;
+  FILE *f = stdin;
+
+  for(i = 1; i < argc && argv[i][0] == '-'; i += 2){
+    if(i + 1 >= argc)
+      usage();
+    if(strcmp(argv[i], "-c") == 0)
+      ncpu = atoi(argv[i + 1]);
+    else if(strcmp(argv[i], "-p") == 0)
+      policy = argv[i + 1];
+    else
+      usage();
+  }
+  if(i < argc && (f = fopen(argv[i], "r")) == 0){
+    perror(argv[i]);
+    exit(1);
+  }
+
+  traced = load(f);
+  if(ntask == 0){
+    fprintf(stderr, "schedsim: no trace events\n");
+    exit(1);
+  }
+  if(ncpu <= 0)
+    ncpu = traced;
+  if(ncpu > MAXCPU)
+    ncpu = MAXCPU;
+
+  for(int p = 0; p < NPOLICY; p++){
+    if(policy && strcmp(policy, policies[p].name) != 0)
+      continue;
+    simulate(&policies[p], ncpu);
+    report(&policies[p], ncpu);
+    ran = 1;
+  }
+  if(!ran)
+    usage();
+  exit(0);
+}
@@ -51,7 +51,7 @@ int main(int argc, char *argv[])
     }
     // for (; n > 0; n--)
     // {
-    //     if (waitx(0, &wtime, &rtime) >= 0)
+    //     if (waitx(0, &wtime, &rtime, 0) >= 0)
     //     {
     //         trtime += rtime;
     //         twtime += wtime;
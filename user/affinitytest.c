@@ -0,0 +1,74 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define NFORK 6
+#define SPIN 200000000
+
+// Run NFORK CPU-bound children, first free to run
+// anywhere, then each pinned to one cpu, and count how
+// often they moved between cpus (getcpu() changed).
+static void
+run(int pinned, int online)
+{
+  int n, pid, cpus[NCPU], ncpu = 0;
+  int wtime, rtime, status;
+  int twtime = 0, trtime = 0, moves = 0;
+  int start = uptime();
+
+  for(int i = 0; i < NCPU; i++)
+    if(online & (1 << i))
+      cpus[ncpu++] = i;
+
+  for(n = 0; n < NFORK; n++)
+  {
+    pid = fork();
+    if(pid < 0)
+      break;
+    if(pid == 0)
+    {
+      int cpu, last, nmove = 0;
+
+      if(pinned)
+        sched_setaffinity(0, 1 << cpus[n % ncpu]);
+      last = getcpu();
+      for(volatile int i = 0; i < SPIN; i++)
+      {
+        if(i % 1000 == 0 && (cpu = getcpu()) != last)
+        {
+          nmove++;
+          last = cpu;
+        }
+      }
+      exit(nmove);
+    }
+  }
+  for(; n > 0; n--)
+  {
+    if(waitx(&status, &wtime, &rtime, 0) >= 0)
+    {
+      trtime += rtime;
+      twtime += wtime;
+      moves += status;
+    }
+  }
+  printf("%s: %d migrations, average rtime %d, wtime %d, %d ticks in all\n",
+         pinned ? "pinned  " : "unpinned", moves, trtime / NFORK,
+         twtime / NFORK, uptime() - start);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int online = sched_getaffinity(0);
+
+  if(online < 0)
+  {
+    fprintf(2, "affinitytest: sched_getaffinity failed\n");
+    exit(1);
+  }
+  run(0, online);
+  run(1, online);
+  exit(0);
+}
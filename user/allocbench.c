@@ -0,0 +1,110 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/riscv.h"
+#include "user/user.h"
+
+// Page allocation throughput as the number of cpus
+// allocating at once grows: 1, 2, ... workers, each
+// pinned to a cpu of its own, grow and shrink their
+// memory with sbrk(), or fork and reap children.
+// Prints one key=value line per test and worker count.
+
+#define NPAGES 16     // pages per sbrk()
+#define NSBRK  2000   // sbrk() rounds per worker
+#define NFORK  200    // forks per worker
+
+static void
+sbrkwork(void)
+{
+  for(int i = 0; i < NSBRK; i++)
+  {
+    char *mem = sbrk(NPAGES * PGSIZE);
+    if(mem == (char*)-1)
+      exit(1);
+    // sbrk() only reserves memory; touch each page
+    // so that it is allocated.
+    for(int j = 0; j < NPAGES; j++)
+      mem[j * PGSIZE] = 1;
+    sbrk(-NPAGES * PGSIZE);
+  }
+}
+
+static void
+forkwork(void)
+{
+  for(int i = 0; i < NFORK; i++)
+  {
+    int pid = fork();
+    if(pid < 0)
+      exit(1);
+    if(pid == 0)
+      exit(0);
+    wait(0);
+  }
+}
+
+static void
+run(char *test, int nworker, int *cpus)
+{
+  int start = uptime(), ticks, status, failed = 0, pages;
+
+  for(int i = 0; i < nworker; i++)
+  {
+    int pid = fork();
+    if(pid < 0)
+    {
+      fprintf(2, "allocbench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0)
+    {
+      sched_setaffinity(0, 1 << cpus[i]);
+      if(strcmp(test, "sbrk") == 0)
+        sbrkwork();
+      else
+        forkwork();
+      exit(0);
+    }
+  }
+  for(int i = 0; i < nworker; i++)
+  {
+    wait(&status);
+    if(status != 0)
+      failed = 1;
+  }
+  ticks = uptime() - start;
+  if(ticks == 0)
+    ticks = 1;
+
+  // pages allocated, and freed again: a fork takes
+  // about 8, for page tables, trapframe and the stack
+  // pages copied on write; its memory is shared.
+  if(strcmp(test, "sbrk") == 0)
+    pages = nworker * NSBRK * NPAGES;
+  else
+    pages = nworker * NFORK * 8;
+  printf("test=%s workers=%d ticks=%d pages_per_tick=%d%s\n",
+         test, nworker, ticks, pages / ticks, failed ? " failed=1" : "");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int online = sched_getaffinity(0), cpus[NCPU], ncpu = 0;
+
+  if(online < 0)
+  {
+    fprintf(2, "allocbench: sched_getaffinity failed\n");
+    exit(1);
+  }
+  for(int i = 0; i < NCPU; i++)
+    if(online & (1 << i))
+      cpus[ncpu++] = i;
+
+  for(int n = 1; n <= ncpu; n++)
+    run("sbrk", n, cpus);
+  for(int n = 1; n <= ncpu; n++)
+    run("fork", n, cpus);
+  exit(0);
+}
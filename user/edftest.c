@@ -0,0 +1,189 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/sched.h"
+#include "user/user.h"
+
+#define NJOBS    20
+#define PERIOD   10  // ticks between job releases
+#define DEADLINE 4   // ticks from release to deadline
+#define RUNTIME  2   // ticks reserved per period
+
+static int spt;      // spin iterations per tick
+
+static void
+spin(int n)
+{
+  for(volatile int i = 0; i < n; i++)
+    ;
+}
+
+// how many iterations of spin() make a tick, on an idle machine.
+static void
+calibrate(void)
+{
+  int t = uptime();
+
+  while(uptime() == t)
+    ;
+  t = uptime();
+  int n = 0;
+  while(uptime() < t + 5)
+  {
+    spin(10000);
+    n += 10000;
+  }
+  spt = n / 5;
+}
+
+// A control loop: each period, a job needing about a
+// tick of cpu, due DEADLINE ticks after its release.
+// Exits with the number of deadlines missed.
+static void
+control(int edf)
+{
+  int release, misses = 0;
+
+  if(edf && sched_setdeadline(RUNTIME, PERIOD, DEADLINE) < 0)
+  {
+    fprintf(2, "edftest: admission failed\n");
+    exit(-1);
+  }
+  release = uptime();
+  for(int j = 0; j < NJOBS; j++)
+  {
+    spin(spt);
+    if(uptime() > release + DEADLINE)
+      misses++;
+    release += PERIOD;
+    if(release > uptime())
+      sleep(release - uptime());
+  }
+  exit(misses);
+}
+
+// Run the control loop against two CPU hogs per cpu.
+static void
+run(int edf, int ncpu)
+{
+  int pids[2*NCPU], pid, misses;
+
+  for(int i = 0; i < 2*ncpu; i++)
+  {
+    if((pids[i] = fork()) == 0)
+    {
+      for(;;)
+        spin(spt);
+    }
+  }
+  if((pid = fork()) == 0)
+    control(edf);
+  wait(&misses);
+  for(int i = 0; i < 2*ncpu; i++)
+  {
+    kill(pids[i]);
+    wait(0);
+  }
+  printf("%s: %d of %d deadlines missed\n", edf ? "EDF" : "RR ", misses, NJOBS);
+}
+
+// Reservations beyond what the cpus have must be refused.
+static void
+admission(int ncpu)
+{
+  int pids[NCPU+1], admitted = 0, status, fds[2];
+  char c;
+
+  pipe(fds);
+  for(int i = 0; i <= ncpu; i++)
+  {
+    if((pids[i] = fork()) == 0)
+    {
+      close(fds[1]);
+      // 60% of a cpu: only one fits on each.
+      if(sched_setdeadline(6, 10, 10) < 0)
+        exit(1);
+      read(fds[0], &c, 1);   // hold it until all have tried
+      exit(0);
+    }
+  }
+  close(fds[0]);
+  sleep(10);
+  close(fds[1]);
+  for(int i = 0; i <= ncpu; i++)
+  {
+    wait(&status);
+    if(status == 0)
+      admitted++;
+  }
+  printf("admission: %d of %d 60%% tasks admitted on %d cpus (%s)\n",
+         admitted, ncpu + 1, ncpu, admitted == ncpu ? "ok" : "wrong");
+}
+
+// An EDF task that spins past its runtime must be throttled
+// until its next period, leaving the rest of its cpu to an
+// RR process there: about 1 - TRUNTIME/TPERIOD of it.
+#define TRUNTIME 3
+#define TPERIOD  10
+#define TTICKS   200   // ticks the RR process runs for
+
+static void
+throttle(void)
+{
+  int fds[2], mask, edf, rr, start, wtime, rtime, edftime, share;
+
+  pipe(fds);
+  if((edf = fork()) == 0)
+  {
+    if(sched_setdeadline(TRUNTIME, TPERIOD, TPERIOD) < 0)
+      exit(1);
+    // tell the parent which cpu the reservation is on.
+    mask = sched_getaffinity(0);
+    write(fds[1], &mask, sizeof(mask));
+    for(;;)
+      spin(spt);
+  }
+  if(read(fds[0], &mask, sizeof(mask)) != sizeof(mask))
+  {
+    fprintf(2, "edftest: throttle: admission failed\n");
+    wait(0);
+    return;
+  }
+  close(fds[0]);
+  close(fds[1]);
+
+  start = uptime();
+  if((rr = fork()) == 0)
+  {
+    sched_setpolicy(SCHED_RR, getpid());
+    sched_setaffinity(0, mask);
+    while(uptime() < start + TTICKS)
+      spin(spt / 10);
+    exit(0);
+  }
+  waitx(0, &wtime, &rtime, 0);
+  kill(edf);
+  waitx(0, &wtime, &edftime, 0);
+
+  share = rtime * 100 / TTICKS;
+  printf("throttle: RR got %d%% of the cpu beside a %d%% EDF spinner (EDF ran %d ticks), expect about %d%% (%s)\n",
+         share, TRUNTIME * 100 / TPERIOD, edftime, 100 - TRUNTIME * 100 / TPERIOD,
+         share >= 100 - TRUNTIME * 100 / TPERIOD - 15 ? "ok" : "starved");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int online = sched_getaffinity(0), ncpu = 0;
+
+  for(int i = 0; i < NCPU; i++)
+    if(online & (1 << i))
+      ncpu++;
+
+  calibrate();
+  run(0, ncpu);
+  run(1, ncpu);
+  admission(ncpu);
+  throttle();
+  exit(0);
+}
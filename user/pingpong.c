@@ -0,0 +1,72 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define NROUND 20000
+
+// Bounce a byte NROUND times between a parent and a
+// child over two pipes, like the ends of a pipeline
+// waiting on each other, and time it. With shared, both
+// run on the first cpu allowed.
+static void
+run(int shared, int online)
+{
+  int to[2], from[2], pid, start;
+  char c = 0;
+
+  if(pipe(to) < 0 || pipe(from) < 0)
+  {
+    fprintf(2, "pingpong: pipe failed\n");
+    exit(1);
+  }
+  if(shared)
+    sched_setaffinity(0, online & -online);
+
+  start = uptime();
+  pid = fork();
+  if(pid < 0)
+  {
+    fprintf(2, "pingpong: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0)
+  {
+    close(to[1]);
+    close(from[0]);
+    while(read(to[0], &c, 1) == 1)
+      write(from[1], &c, 1);
+    exit(0);
+  }
+  close(to[0]);
+  close(from[1]);
+  for(int i = 0; i < NROUND; i++)
+  {
+    write(to[1], &c, 1);
+    if(read(from[0], &c, 1) != 1)
+    {
+      fprintf(2, "pingpong: read failed\n");
+      exit(1);
+    }
+  }
+  close(to[1]);
+  close(from[0]);
+  wait(0);
+  printf("%s: %d round trips in %d ticks\n",
+         shared ? "one cpu " : "any cpus", NROUND, uptime() - start);
+  sched_setaffinity(0, online);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int online = sched_getaffinity(0);
+
+  if(online < 0)
+  {
+    fprintf(2, "pingpong: sched_getaffinity failed\n");
+    exit(1);
+  }
+  run(0, online);
+  run(1, online);
+  exit(0);
+}
@@ -0,0 +1,59 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+static void
+show(int pgid)
+{
+  int rtime, nthrottle, quota;
+
+  if((quota = quotastat(pgid, &rtime, &nthrottle)) < 0)
+  {
+    printf("group %d: no quota\n", pgid);
+    return;
+  }
+  printf("group %d: quota %d%%, used %d ticks, out of quota in %d periods\n",
+         pgid, quota, rtime, nthrottle);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int pgid, quota;
+
+  if(argc >= 4 && strcmp(argv[1], "run") == 0)
+  {
+    // run a command in a new group of its own.
+    quota = atoi(argv[2]);
+    setpgid(0, 0);
+    if(setquota(getpid(), quota) < 0)
+    {
+      fprintf(2, "quota: cannot set quota %d%%\n", quota);
+      exit(1);
+    }
+    exec(argv[3], argv + 3);
+    fprintf(2, "quota: exec %s failed\n", argv[3]);
+    exit(1);
+  }
+
+  if(argc < 2)
+  {
+    fprintf(2, "Usage: quota <pgid> [percent]\n");
+    fprintf(2, "       quota run <percent> <command> [args...]\n");
+    exit(1);
+  }
+
+  pgid = atoi(argv[1]);
+  if(argc > 2)
+  {
+    quota = atoi(argv[2]);
+    if(setquota(pgid, quota) < 0)
+    {
+      fprintf(2, "quota: cannot set group %d to %d%%\n", pgid, quota);
+      exit(1);
+    }
+  }
+  show(pgid);
+  exit(0);
+}
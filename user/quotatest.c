@@ -0,0 +1,70 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define QUOTA    40
+#define RUNTICKS 100
+
+// A batch group of two CPU hogs per cpu, capped at QUOTA
+// percent of all the cpus, runs for RUNTICKS. It should
+// use about QUOTA percent of the cpu time there was, and
+// an interactive process outside it should still get its
+// sleeps answered on time.
+int
+main(int argc, char *argv[])
+{
+  int online = sched_getaffinity(0), ncpu = 0;
+  int batch, pgid, rtime, nthrottle, start, late = 0;
+  int fds[2];
+  char c;
+
+  for(int i = 0; i < NCPU; i++)
+    if(online & (1 << i))
+      ncpu++;
+
+  pipe(fds);
+  start = uptime();
+  batch = fork();
+  if(batch == 0)
+  {
+    close(fds[0]);
+    setpgid(0, 0);
+    setquota(getpid(), QUOTA);
+    for(int i = 0; i < 2*ncpu; i++)
+    {
+      if(fork() == 0)
+      {
+        while(uptime() < start + RUNTICKS)
+          ;
+        exit(0);
+      }
+    }
+    for(int i = 0; i < 2*ncpu; i++)
+      wait(0);
+    write(fds[1], "x", 1);
+    exit(0);
+  }
+  close(fds[1]);
+
+  // the interactive side: sleep a tick, see how late it wakes.
+  while(uptime() < start + RUNTICKS)
+  {
+    int t = uptime();
+    sleep(1);
+    if(uptime() > t + 2)
+      late++;
+  }
+
+  read(fds[0], &c, 1);
+  wait(0);
+
+  // the quota outlives the group's processes.
+  pgid = batch;
+  quotastat(pgid, &rtime, &nthrottle);
+  printf("batch group: %d ticks of %d cpu ticks (%d%%, quota %d%%), out of quota in %d periods\n",
+         rtime, ncpu * RUNTICKS, rtime * 100 / (ncpu * RUNTICKS), QUOTA, nthrottle);
+  printf("interactive: %d late wakeups\n", late);
+  setquota(pgid, 0);
+  exit(0);
+}
@@ -0,0 +1,72 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/sched.h"
+#include "user/user.h"
+
+static char *names[] = {
+  [SCHED_RR]     "RR",
+  [SCHED_FCFS]   "FCFS",
+  [SCHED_PBS]    "PBS",
+  [SCHED_MLFQ]   "MLFQ",
+  [SCHED_CFS]    "CFS",
+  [SCHED_STRIDE] "STRIDE",
+  [SCHED_EDF]    "EDF",
+};
+
+int
+main(int argc, char *argv[])
+{
+  int policy, pid, old, slice;
+
+  if(argc < 2)
+  {
+    old = sched_setpolicy(-1, 0);
+    if(old >= 0 && old < NSCHED)
+      printf("%s\n", names[old]);
+    exit(0);
+  }
+
+  for(policy = 0; policy < NSCHED; policy++)
+    if(strcmp(argv[1], names[policy]) == 0)
+      break;
+  if(policy == NSCHED)
+  {
+    fprintf(2, "Usage: schedpolicy [RR|FCFS|PBS|MLFQ|CFS|STRIDE [pid | slice [ticks]]]\n");
+    exit(1);
+  }
+
+  // time slice of the policy, in ticks; 0 never expires.
+  if(argc > 2 && strcmp(argv[2], "slice") == 0)
+  {
+    slice = -1;   // just print it
+    if(argc > 3)
+      slice = atoi(argv[3]);
+    old = sched_setslice(policy, slice);
+    if(slice < 0)
+      printf("%s slice %d\n", names[policy], old);
+    else
+      printf("%s slice %d -> %d\n", names[policy], old, slice);
+    exit(0);
+  }
+
+  if(policy == SCHED_EDF)
+  {
+    fprintf(2, "schedpolicy: a process becomes EDF with sched_setdeadline()\n");
+    exit(1);
+  }
+
+  pid = 0;    // the whole system
+  if(argc > 2)
+    pid = atoi(argv[2]);
+
+  old = sched_setpolicy(policy, pid);
+  if(old < 0)
+  {
+    fprintf(2, "schedpolicy: no process %d\n", pid);
+    exit(1);
+  }
+  printf("%s -> %s\n", names[old], names[policy]);
+
+  exit(0);
+}
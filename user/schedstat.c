@@ -0,0 +1,159 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/sched.h"
+#include "user/user.h"
+
+// Read every cpu's counters into st[]; returns a
+// mask of the cpus that are running.
+static int
+snapshot(struct schedstat *st)
+{
+  int online = 0;
+
+  for(int i = 0; i < NCPU; i++)
+  {
+    memset(&st[i], 0, sizeof(st[i]));
+    if(schedstat(i, &st[i]) == 0)
+      online |= 1 << i;
+  }
+  return online;
+}
+
+// The wait, in microseconds, that pct percent of the
+// switches in lat[] waited less than; the top of the
+// histogram bucket it falls in.
+static int
+percentile(uint *lat, uint n, int pct)
+{
+  uint seen = 0;
+  int i;
+
+  for(i = 0; i < NLATHIST - 1; i++)
+  {
+    seen += lat[i];
+    if((uint64)seen * 100 >= (uint64)n * pct)
+      break;
+  }
+  return 1 << i;
+}
+
+static void
+prefix(int cpu)
+{
+  if(cpu < 0)
+    printf("all: ");
+  else
+    printf("cpu %d: ", cpu);
+}
+
+// Print st, of cpu, or of all of them if cpu is -1.
+static void
+show(int cpu, struct schedstat *st)
+{
+  uint64 busy = st->time - st->idle;
+  int util = st->time ? (int)(busy * 100 / st->time) : 0;
+
+  prefix(cpu);
+  printf("%d%% busy, %d switches (%d blocked, %d preempted), %d migrations, "
+         "%d stolen, %d balanced, %d handoffs, %d queued\n",
+         util, st->nswitch, st->nvcsw, st->nivcsw, st->nmigrate,
+         st->nsteal, st->nbalance, st->nhandoff, st->nqueued);
+  if(st->nswitch > 0)
+  {
+    prefix(cpu);
+    printf("queue wait p50 <%dus, p90 <%dus, p99 <%dus, max <%dus\n",
+           percentile(st->lat, st->nswitch, 50),
+           percentile(st->lat, st->nswitch, 90),
+           percentile(st->lat, st->nswitch, 99),
+           percentile(st->lat, st->nswitch, 100));
+  }
+}
+
+// Print the counters of the cpus in online, the change
+// from before[] to after[], and their sum.
+static void
+report(struct schedstat *before, struct schedstat *after, int online)
+{
+  struct schedstat d, sum;
+
+  memset(&sum, 0, sizeof(sum));
+  for(int i = 0; i < NCPU; i++)
+  {
+    if(!(online & (1 << i)))
+      continue;
+    d.time = after[i].time - before[i].time;
+    d.idle = after[i].idle - before[i].idle;
+    d.nswitch = after[i].nswitch - before[i].nswitch;
+    d.nvcsw = after[i].nvcsw - before[i].nvcsw;
+    d.nivcsw = after[i].nivcsw - before[i].nivcsw;
+    d.nmigrate = after[i].nmigrate - before[i].nmigrate;
+    d.nsteal = after[i].nsteal - before[i].nsteal;
+    d.nbalance = after[i].nbalance - before[i].nbalance;
+    d.nhandoff = after[i].nhandoff - before[i].nhandoff;
+    d.nqueued = after[i].nqueued;
+    for(int j = 0; j < NLATHIST; j++)
+      d.lat[j] = after[i].lat[j] - before[i].lat[j];
+
+    show(i, &d);
+
+    sum.time += d.time;
+    sum.idle += d.idle;
+    sum.nswitch += d.nswitch;
+    sum.nvcsw += d.nvcsw;
+    sum.nivcsw += d.nivcsw;
+    sum.nmigrate += d.nmigrate;
+    sum.nsteal += d.nsteal;
+    sum.nbalance += d.nbalance;
+    sum.nhandoff += d.nhandoff;
+    sum.nqueued += d.nqueued;
+    for(int j = 0; j < NLATHIST; j++)
+      sum.lat[j] += d.lat[j];
+  }
+  show(-1, &sum);
+}
+
+int
+main(int argc, char *argv[])
+{
+  static struct schedstat before[NCPU], after[NCPU];
+  struct procstat ps;
+  int online, pid, status, wtime, rtime;
+
+  if(argc < 2)
+  {
+    // since boot.
+    memset(before, 0, sizeof(before));
+    online = snapshot(after);
+    report(before, after, online);
+    exit(0);
+  }
+
+  // while a command runs.
+  snapshot(before);
+  pid = fork();
+  if(pid < 0)
+  {
+    fprintf(2, "schedstat: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0)
+  {
+    exec(argv[1], argv + 1);
+    fprintf(2, "schedstat: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+  if(waitx(&status, &wtime, &rtime, &ps) < 0)
+  {
+    fprintf(2, "schedstat: waitx failed\n");
+    exit(1);
+  }
+  online = snapshot(after);
+
+  printf("%s: exit %d, rtime %d, queued %d, sleeping %d ticks, "
+         "%d switches (%d blocked, %d preempted), %d migrations\n",
+         argv[1], status, ps.rtime, ps.wtime, ps.stime,
+         ps.nrun, ps.nvcsw, ps.nivcsw, ps.nmigrate);
+  report(before, after, online);
+  exit(0);
+}
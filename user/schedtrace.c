@@ -0,0 +1,56 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/sched.h"
+#include "kernel/memlayout.h"
+#include "user/user.h"
+
+// Trace the scheduler while a command runs, and print the
+// events, one per line, for sim/schedsim on the host:
+//   T <time> <cpu> <pid> <event> <policy> <priority>
+// with time in microseconds since the trace started.
+// Lines starting with # are comments.
+
+#define NREC 64
+#define USCYCLES (MTIMEHZ / 1000000)   // cycles per microsecond
+
+int
+main(int argc, char *argv[])
+{
+  static struct tracerec rec[NREC];
+  int pid, lost, n;
+
+  if(argc < 2)
+  {
+    fprintf(2, "Usage: schedtrace <command> [args...]\n");
+    exit(1);
+  }
+
+  schedtrace(1);
+  pid = fork();
+  if(pid < 0)
+  {
+    schedtrace(0);
+    fprintf(2, "schedtrace: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0)
+  {
+    exec(argv[1], argv + 1);
+    fprintf(2, "schedtrace: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+  wait(0);
+  lost = schedtrace(0);
+
+  printf("# schedtrace %s us-per-tick %d\n", argv[1], TICKCYCLES / USCYCLES);
+  if(lost > 0)
+    printf("# lost %d\n", lost);
+  while((n = readtrace(rec, NREC)) > 0)
+  {
+    for(int i = 0; i < n; i++)
+      printf("T %d %d %d %d %d %d\n", (int)(rec[i].time / USCYCLES), rec[i].cpu,
+             rec[i].pid, rec[i].event, rec[i].policy, rec[i].priority);
+  }
+  exit(0);
+}
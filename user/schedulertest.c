@@ -1,55 +1,280 @@
+#include "kernel/param.h"
 #include "kernel/types.h"
 #include "kernel/stat.h"
+#include "kernel/sched.h"
 #include "user/user.h"
 #include "kernel/fcntl.h"
 
-#define NFORK 10
-#define IO 5
+// A scheduler benchmark. Each workload forks nproc
+// children, waits for them all and prints one line of
+// key=value pairs:
+//   ticks           time from the first fork to the last exit
+//   throughput      children finished per 1000 ticks
+//   turnaround_*    mean and 99th percentile of a child's
+//                   life, fork to exit, in ticks
+//   wtime_mean      mean ticks a child spent waiting to run,
+//                   not counting sleep
+//   rtime_mean      mean ticks a child spent running
+//   jain            Jain's fairness index of the share of its
+//                   life each child ran, in thousandths: 1000
+//                   when all got the same share
+// prio also prints turnaround_hi and turnaround_lo, the mean
+// of the children with high and low priority.
 
-int main()
+#define MAXPROC 64                // most children; pipe and fork fork as many again
+#define NIO     10                // sleeps per io child
+#define NROUND  1000              // round trips per pipe child
+#define NSTORM  20                // processes each fork child forks
+#define NWORKLOAD (sizeof(workloads) / sizeof(workloads[0]))
+
+static char *names[] = {
+  [SCHED_RR]     "RR",
+  [SCHED_FCFS]   "FCFS",
+  [SCHED_PBS]    "PBS",
+  [SCHED_MLFQ]   "MLFQ",
+  [SCHED_CFS]    "CFS",
+  [SCHED_STRIDE] "STRIDE",
+  [SCHED_EDF]    "EDF",
+};
+
+static char *workloads[] = { "cpu", "io", "pipe", "fork", "prio", "mixed" };
+
+static int nproc = 10;
+static int loops = 100;           // millions of iterations per cpu child
+
+static void
+spin(int n)
+{
+  for(volatile int i = 0; i < n; i++)
+    ;
+}
+
+static void
+cpuwork(void)
+{
+  for(int m = 0; m < loops; m++)
+    spin(1000000);
+}
+
+static void
+iowork(void)
 {
-    int n, pid;
-    int wtime, rtime;
-    int twtime = 0, trtime = 0;
-    for (n = 0; n < NFORK; n++)
+  for(int i = 0; i < NIO; i++)
+  {
+    sleep(5);
+    spin(loops * 10000);
+  }
+}
+
+// bounce a byte over two pipes with a child of our own.
+static void
+pipework(void)
+{
+  int to[2], from[2];
+  char c = 0;
+
+  if(pipe(to) < 0 || pipe(from) < 0)
+    exit(1);
+  if(fork() == 0)
+  {
+    close(to[1]);
+    close(from[0]);
+    while(read(to[0], &c, 1) == 1)
+      write(from[1], &c, 1);
+    exit(0);
+  }
+  close(to[0]);
+  close(from[1]);
+  for(int i = 0; i < NROUND; i++)
+  {
+    write(to[1], &c, 1);
+    if(read(from[0], &c, 1) != 1)
+      exit(1);
+  }
+  close(to[1]);
+  close(from[0]);
+  wait(0);
+}
+
+static void
+forkwork(void)
+{
+  for(int i = 0; i < NSTORM; i++)
+  {
+    int pid = fork();
+    if(pid < 0)
+      exit(1);
+    if(pid == 0)
+      exit(0);
+    wait(0);
+  }
+}
+
+// the work child n of workload w does.
+static void
+child(char *w, int n)
+{
+  if(strcmp(w, "io") == 0 || (strcmp(w, "mixed") == 0 && n < nproc / 2))
+    iowork();
+  else if(strcmp(w, "pipe") == 0)
+    pipework();
+  else if(strcmp(w, "fork") == 0)
+    forkwork();
+  else
+    cpuwork();
+  exit(0);
+}
+
+static void
+sort(int *a, int n)
+{
+  for(int i = 1; i < n; i++)
+  {
+    int x = a[i], j;
+    for(j = i; j > 0 && a[j - 1] > x; j--)
+      a[j] = a[j - 1];
+    a[j] = x;
+  }
+}
+
+static void
+run(char *w, int policy)
+{
+  int pids[MAXPROC], turn[MAXPROC], hi[MAXPROC];
+  int wtime, rtime, status, pid, n, i;
+  struct procstat ps;
+  int twtime = 0, trtime = 0, tturn = 0, thi = 0, tlo = 0, nhi = 0;
+  uint64 share, sum = 0, sumsq = 0;
+  int start = uptime(), ticks;
+
+  for(n = 0; n < nproc; n++)
+  {
+    pid = fork();
+    if(pid < 0)
+      break;
+    if(pid == 0)
+      child(w, n);
+    pids[n] = pid;
+    // prio: every other child is more important.
+    hi[n] = n % 2 == 0;
+    if(strcmp(w, "prio") == 0)
+      setpriority(hi[n] ? 40 : 80, pid);
+  }
+
+  for(i = 0; i < n; i++)
+  {
+    pid = waitx(&status, &wtime, &rtime, &ps);
+    if(pid < 0)
+      break;
+    turn[i] = wtime + rtime;
+    twtime += ps.wtime;
+    trtime += rtime;
+    tturn += turn[i];
+    share = turn[i] > 0 ? (uint64)rtime * 1000 / turn[i] : 1000;
+    sum += share;
+    sumsq += share * share;
+    for(int j = 0; j < n; j++)
+    {
+      if(pids[j] != pid)
+        continue;
+      if(hi[j])
+      {
+        thi += turn[i];
+        nhi++;
+      }
+      else
+        tlo += turn[i];
+      break;
+    }
+  }
+  if(i == 0)
+  {
+    fprintf(2, "schedulertest: %s: no children\n", w);
+    return;
+  }
+  n = i;
+  ticks = uptime() - start;
+  if(ticks == 0)
+    ticks = 1;
+  sort(turn, n);
+
+  printf("workload=%s policy=%s nproc=%d ticks=%d throughput=%d "
+         "turnaround_mean=%d turnaround_p99=%d wtime_mean=%d rtime_mean=%d jain=%d",
+         w, policy >= 0 && policy < NSCHED ? names[policy] : "?", n, ticks,
+         n * 1000 / ticks, tturn / n, turn[(n * 99 + 99) / 100 - 1],
+         twtime / n, trtime / n,
+         sumsq > 0 ? (int)(sum * sum * 1000 / (n * sumsq)) : 1000);
+  if(strcmp(w, "prio") == 0 && nhi > 0 && nhi < n)
+    printf(" turnaround_hi=%d turnaround_lo=%d", thi / nhi, tlo / (n - nhi));
+  printf("\n");
+}
+
+static void
+usage(void)
+{
+  fprintf(2, "Usage: schedulertest [-n nproc] [-l millions] [-p policy] "
+             "[cpu|io|pipe|fork|prio|mixed|all]...\n");
+  exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, policy = -1, old, ran;
+
+  for(i = 1; i < argc && argv[i][0] == '-'; i += 2)
+  {
+    if(i + 1 >= argc)
+      usage();
+    if(strcmp(argv[i], "-n") == 0)
+      nproc = atoi(argv[i + 1]);
+    else if(strcmp(argv[i], "-l") == 0)
+      loops = atoi(argv[i + 1]);
+    else if(strcmp(argv[i], "-p") == 0)
     {
-        pid = fork();
-        if (pid < 0)
-            break;
-        if (pid == 0)
-        {
-            #ifndef FCFS
-            if (n < IO)
-            {
-                sleep(200); // IO bound processes
-            }
-            else
-            {
-            #endif
-                for (volatile int i = 0; i < 2000000000; i++)
-                {
-                } // CPU bound process
-            #ifndef FCFS
-            }
-            #endif
-            printf("Process %d finished\n", n);
-            exit(0);
-        }
-        else
-        {
-            #ifdef PBS
-            setpriority(80, pid); // Will only matter for PBS, set lower priority for IO bound processes
-            #endif
-        }
+      for(policy = 0; policy < SCHED_EDF; policy++)
+        if(strcmp(argv[i + 1], names[policy]) == 0)
+          break;
+      if(policy == SCHED_EDF)
+        usage();
     }
-    for (; n > 0; n--)
+    else
+      usage();
+  }
+  if(nproc < 1 || nproc > MAXPROC || loops < 0)
+  {
+    fprintf(2, "schedulertest: nproc must be 1 to %d\n", MAXPROC);
+    exit(1);
+  }
+
+  // run under policy, putting the old one back after.
+  old = sched_setpolicy(-1, 0);
+  if(policy >= 0)
+    sched_setpolicy(policy, 0);
+  else
+    policy = old;
+
+  if(i == argc)
+    run("mixed", policy);
+  for(; i < argc; i++)
+  {
+    ran = 0;
+    for(int w = 0; w < NWORKLOAD; w++)
     {
-        if (waitx(0, &wtime, &rtime) >= 0)
-        {
-            trtime += rtime;
-            twtime += wtime;
-        }
+      if(strcmp(argv[i], "all") == 0 || strcmp(argv[i], workloads[w]) == 0)
+      {
+        run(workloads[w], policy);
+        ran = 1;
+      }
     }
-    printf("Average rtime %d,  wtime %d\n", trtime / NFORK, twtime / NFORK);
-    exit(0);
+    if(!ran)
+    {
+      fprintf(2, "schedulertest: no workload %s\n", argv[i]);
+      break;
+    }
+  }
+
+  if(old >= 0)
+    sched_setpolicy(old, 0);
+  exit(0);
 }
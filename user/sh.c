@@ -153,10 +153,18 @@ main(void)
   #else
   #ifdef PBS
     printf("PBS\n");
-  // #else
-  // #ifdef MLFQ
-  //   printf("MLFQ\n");
-  // #endif
+  #else
+  #ifdef MLFQ
+    printf("MLFQ\n");
+  #else
+  #ifdef CFS
+    printf("CFS\n");
+  #else
+  #ifdef STRIDE
+    printf("STRIDE\n");
+  #endif
+  #endif
+  #endif
   #endif
   #endif
   #endif
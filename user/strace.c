@@ -3,6 +3,17 @@
 #include "kernel/stat.h"
 #include "user/user.h"
 
+// the mask, in decimal; atoi() would stop at 32 bits.
+static uint64
+atomask(char *s)
+{
+  uint64 n = 0;
+
+  while('0' <= *s && *s <= '9')
+    n = n*10 + *s++ - '0';
+  return n;
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -15,7 +26,7 @@ main(int argc, char *argv[])
     exit(1);
   }
 
-  if (strace(atoi(argv[1])) < 0) 
+  if (strace(atomask(argv[1])) < 0) 
   {
     fprintf(2, "%s: strace failed\n", argv[0]);
     exit(1);
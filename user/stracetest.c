@@ -0,0 +1,31 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/syscall.h"
+#include "user/user.h"
+
+// Trace only getpgid, a system call numbered above 31,
+// then make it and the calls whose bits a 32-bit mask
+// would alias it with (fork is 33 - 32). Only getpgid
+// should be traced, once.
+int
+main(int argc, char *argv[])
+{
+  int pid;
+
+  printf("stracetest: expect one trace line, for getpgid\n");
+  if(strace(1L << SYS_getpgid) < 0)
+  {
+    fprintf(2, "stracetest: strace failed\n");
+    exit(1);
+  }
+  getpgid(0);
+  pid = fork();
+  if(pid == 0)
+    exit(0);
+  wait(0);
+  getpid();
+  strace(0);
+  printf("stracetest: done\n");
+  exit(0);
+}
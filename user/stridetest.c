@@ -0,0 +1,132 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/sched.h"
+#include "user/user.h"
+
+#define RUNTICKS 100
+
+// Start a STRIDE child on cpu with the given priority
+// (101 - priority tickets), spinning until tick end.
+static int
+hog(int cpu, int priority, int end)
+{
+  int pid = fork();
+
+  if(pid == 0)
+  {
+    sched_setaffinity(0, 1 << cpu);
+    setpriority(priority, getpid());
+    sched_setpolicy(SCHED_STRIDE, getpid());
+    while(uptime() < end)
+      ;
+    exit(0);
+  }
+  return pid;
+}
+
+// Wait for the n children in pids[] to exit, and
+// store the run time of each in rtimes[].
+static void
+reap(int n, int *pids, int *rtimes)
+{
+  int pid, status, wtime, rtime;
+
+  for(int i = 0; i < n; i++)
+  {
+    pid = waitx(&status, &wtime, &rtime, 0);
+    for(int j = 0; j < n; j++)
+      if(pids[j] == pid)
+        rtimes[j] = rtime;
+  }
+}
+
+// Three processes with 30, 60 and 90 tickets share one
+// cpu; they should get about 1/6, 2/6 and 3/6 of it.
+static void
+shares(int cpu)
+{
+  int end = uptime() + RUNTICKS;
+  int pids[3], rtimes[3];
+
+  pids[0] = hog(cpu, 71, end);
+  pids[1] = hog(cpu, 41, end);
+  pids[2] = hog(cpu, 11, end);
+  reap(3, pids, rtimes);
+
+  printf("tickets 30:60:90, rtime %d:%d:%d\n", rtimes[0], rtimes[1], rtimes[2]);
+}
+
+// A client with 100 tickets asks a server with 1 ticket to
+// do work over a pipe, while a hog with 50 competes. The
+// client lends its tickets to the server while it waits
+// for a reply, so the server should get about twice the
+// hog's time rather than 1/50 of it.
+static void
+transfer(int cpu)
+{
+  int req[2], rep[2], pids[3], rtimes[3], n;
+  int end = uptime() + RUNTICKS;
+  char c;
+
+  pipe(req);
+  pipe(rep);
+
+  pids[0] = fork();
+  if(pids[0] == 0)
+  {
+    sched_setaffinity(0, 1 << cpu);
+    setpriority(100, getpid());
+    sched_setpolicy(SCHED_STRIDE, getpid());
+    close(req[1]);
+    close(rep[0]);
+    while(read(req[0], &c, 1) == 1)
+    {
+      for(volatile int i = 0; i < 1000000; i++)
+        ;
+      write(rep[1], &c, 1);
+    }
+    exit(0);
+  }
+
+  pids[1] = fork();
+  if(pids[1] == 0)
+  {
+    sched_setaffinity(0, 1 << cpu);
+    setpriority(1, getpid());
+    sched_setpolicy(SCHED_STRIDE, getpid());
+    close(req[0]);
+    close(rep[1]);
+    for(n = 0; uptime() < end; n++)
+    {
+      write(req[1], "x", 1);
+      if(read(rep[0], &c, 1) != 1)
+        break;
+    }
+    printf("client: %d requests served\n", n);
+    exit(0);
+  }
+
+  pids[2] = hog(cpu, 51, end);
+  close(req[0]);
+  close(req[1]);
+  close(rep[0]);
+  close(rep[1]);
+
+  reap(3, pids, rtimes);
+  printf("server (1 ticket + lent) rtime %d, hog (50 tickets) rtime %d\n",
+         rtimes[0], rtimes[2]);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int online = sched_getaffinity(0), cpu = 0;
+
+  while(online > 0 && (online & (1 << cpu)) == 0)
+    cpu++;
+
+  shares(cpu);
+  transfer(cpu);
+  exit(0);
+}
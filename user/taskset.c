@@ -0,0 +1,83 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+// parse a cpu list like "0,2" or "1-3" into a mask.
+static int
+cpulist(char *s)
+{
+  int mask = 0, lo, hi;
+
+  while(*s)
+  {
+    if(*s < '0' || *s > '9')
+      return 0;
+    lo = hi = atoi(s);
+    while(*s >= '0' && *s <= '9')
+      s++;
+    if(*s == '-')
+    {
+      s++;
+      hi = atoi(s);
+      while(*s >= '0' && *s <= '9')
+        s++;
+    }
+    if(lo < 0 || hi >= NCPU || lo > hi)
+      return 0;
+    for(; lo <= hi; lo++)
+      mask |= 1 << lo;
+    if(*s == ',')
+      s++;
+  }
+  return mask;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int mask, pid;
+
+  if(argc >= 3 && strcmp(argv[1], "-p") == 0)
+  {
+    // taskset -p pid: print its cpus.
+    // taskset -p cpus pid: move it to them.
+    pid = atoi(argv[argc-1]);
+    if(argc > 3)
+    {
+      if((mask = cpulist(argv[2])) == 0 || sched_setaffinity(pid, mask) < 0)
+      {
+        fprintf(2, "taskset: cannot set pid %d to cpus %s\n", pid, argv[2]);
+        exit(1);
+      }
+    }
+    if((mask = sched_getaffinity(pid)) < 0)
+    {
+      fprintf(2, "taskset: no process %d\n", pid);
+      exit(1);
+    }
+    printf("pid %d: cpus", pid);
+    for(int i = 0; i < NCPU; i++)
+      if(mask & (1 << i))
+        printf(" %d", i);
+    printf("\n");
+    exit(0);
+  }
+
+  if(argc < 3 || (mask = cpulist(argv[1])) == 0)
+  {
+    fprintf(2, "Usage: taskset <cpus> <command> [args...]\n");
+    fprintf(2, "       taskset -p [cpus] <pid>\n");
+    fprintf(2, "cpus is a list like 0,2 or 1-3\n");
+    exit(1);
+  }
+
+  if(sched_setaffinity(0, mask) < 0)
+  {
+    fprintf(2, "taskset: no started cpu in %s\n", argv[1]);
+    exit(1);
+  }
+  exec(argv[2], argv + 2);
+  fprintf(2, "taskset: exec %s failed\n", argv[2]);
+  exit(1);
+}
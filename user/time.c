@@ -1,5 +1,7 @@
+#include "kernel/param.h"
 #include "kernel/types.h"
 #include "kernel/stat.h"
+#include "kernel/sched.h"
 #include "user/user.h"
 #include "kernel/fcntl.h"
 
@@ -28,8 +30,11 @@ int main(int argc, char **argv)
     else
     {
         int rtime, wtime;
-        waitx(0, &wtime, &rtime);
+        struct procstat ps;
+        waitx(0, &wtime, &rtime, &ps);
         printf("\nwaiting:%d\nrunning:%d\n", wtime, rtime);
+        printf("queued:%d\nsleeping:%d\nswitches:%d (%d blocked, %d preempted, %d migrations)\n",
+               ps.wtime, ps.stime, ps.nrun, ps.nvcsw, ps.nivcsw, ps.nmigrate);
     }
     exit(0);
 }
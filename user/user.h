@@ -1,5 +1,8 @@
 struct stat;
 struct rtcdate;
+struct procstat;
+struct schedstat;
+struct tracerec;
 
 // system calls
 int fork(void);
@@ -23,9 +26,23 @@ int getpid(void);
 char* sbrk(int);
 int sleep(int);
 int uptime(void);
-int strace(int);
-int waitx(int*, int* /*wtime*/, int* /*rtime*/);    // (Q2)
+int strace(uint64);
+int waitx(int*, int* /*wtime*/, int* /*rtime*/, struct procstat*);    // (Q2)
 int setpriority(int /*priority*/, int /*pid*/);    // (Q2 - PBS)
+int sched_setpolicy(int /*policy*/, int /*pid*/);
+int sched_setslice(int /*policy*/, int /*ticks*/);
+int nanosleep(int /*sec*/, int /*nsec*/);
+int sched_setaffinity(int /*pid*/, int /*mask*/);
+int sched_getaffinity(int /*pid*/);
+int getcpu(void);
+int sched_setdeadline(int /*runtime*/, int /*period*/, int /*deadline*/);
+int setpgid(int /*pid*/, int /*pgid*/);
+int getpgid(int /*pid*/);
+int setquota(int /*pgid*/, int /*percent*/);
+int quotastat(int /*pgid*/, int* /*rtime*/, int* /*nthrottle*/);
+int schedstat(int /*cpu*/, struct schedstat*);
+int schedtrace(int /*on*/);
+int readtrace(struct tracerec*, int);
 
 // ulib.c
 int stat(const char*, struct stat*);
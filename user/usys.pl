@@ -39,3 +39,17 @@ entry("uptime");
 entry("strace");        #**
 entry("waitx");         # (Q2)
 entry("setpriority");         # (Q2  PBS)
+entry("sched_setpolicy");
+entry("sched_setslice");
+entry("nanosleep");
+entry("sched_setaffinity");
+entry("sched_getaffinity");
+entry("getcpu");
+entry("sched_setdeadline");
+entry("setpgid");
+entry("getpgid");
+entry("setquota");
+entry("quotastat");
+entry("schedstat");
+entry("schedtrace");
+entry("readtrace");